@@ -14,67 +14,78 @@
 #include <cmath>
 #include <variant>
 #include <type_traits>
+#include <string_view>
+#include <array>
+#include <cstdint>
 #include <fmt/format.h>
 #include <fmt/args.h>
 #include <chrono>
+#include <atomic>
+#include <memory>
+#include <mutex>
 
 // 前向声明配置条目结构
 struct wbcffi_config_entry;
 
 namespace waybar::cffi::common {
 
-// 日志记录函数 - 使用fmt库风格的格式化
-template <typename... Args> void log_error(fmt::format_string<Args...> fmt, Args &&...args) {
-    auto now = std::chrono::system_clock::now();
-    auto time_t = std::chrono::system_clock::to_time_t(now);
-    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()) % 1000;
+// 日志级别，数值越大越详细
+enum class LogLevel : int {
+    Off = -1,
+    Error = 0,
+    Warning = 1,
+    Info = 2,
+};
+
+namespace detail {
+
+// 当前日志级别，日志调用在格式化之前先检查它
+extern std::atomic<int> log_level;
 
-    std::ostringstream oss;
-    oss << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
-    oss << '.' << std::setfill('0') << std::setw(3) << ms.count();
+// 格式化消息并放入环形缓冲区，由后台线程输出；缓冲区满时丢弃消息而不是阻塞调用者
+void log_enqueue(LogLevel level, fmt::string_view format, fmt::format_args args);
 
-    // 使用fmt库格式化消息
-    std::string message = fmt::vformat(fmt, fmt::make_format_args(args...));
+} // namespace detail
 
-    // 使用ANSI颜色代码：红色表示错误
-    fprintf(stderr, "[%s] [\033[0;31merror\033[0m] %s\n", oss.str().c_str(), message.c_str());
+// 判断某个级别的日志是否会被输出
+inline bool log_enabled(LogLevel level) {
+    return static_cast<int>(level) <= detail::log_level.load(std::memory_order_relaxed);
 }
 
-template <typename... Args> void log_warning(fmt::format_string<Args...> fmt, Args &&...args) {
-    auto now = std::chrono::system_clock::now();
-    auto time_t = std::chrono::system_clock::to_time_t(now);
-    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()) % 1000;
+// 设置日志级别，对加载了本模块库的所有实例生效
+void set_log_level(LogLevel level);
 
-    std::ostringstream oss;
-    oss << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
-    oss << '.' << std::setfill('0') << std::setw(3) << ms.count();
+// 解析日志级别名称（"off"、"error"、"warning"、"info"），无法识别时返回fallback
+LogLevel parse_log_level(const std::string &name, LogLevel fallback);
 
-    // 使用fmt库格式化消息
-    std::string message = fmt::vformat(fmt, fmt::make_format_args(args...));
+// 日志记录函数 - 使用fmt库风格的格式化
+// 时间戳在调用时记录，格式化后的消息交给后台线程写入stderr/stdout，
+// 调用线程不会因输出管道阻塞
+template <typename... Args> void log_error(fmt::format_string<Args...> fmt, Args &&...args) {
+    if (log_enabled(LogLevel::Error)) {
+        detail::log_enqueue(LogLevel::Error, fmt, fmt::make_format_args(args...));
+    }
+}
 
-    // 使用ANSI颜色代码：黄色表示警告
-    fprintf(stderr, "[%s] [\033[0;33mwarning\033[0m] %s\n", oss.str().c_str(), message.c_str());
+template <typename... Args> void log_warning(fmt::format_string<Args...> fmt, Args &&...args) {
+    if (log_enabled(LogLevel::Warning)) {
+        detail::log_enqueue(LogLevel::Warning, fmt, fmt::make_format_args(args...));
+    }
 }
 
 template <typename... Args> void log_info(fmt::format_string<Args...> fmt, Args &&...args) {
-    auto now = std::chrono::system_clock::now();
-    auto time_t = std::chrono::system_clock::to_time_t(now);
-    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()) % 1000;
-
-    std::ostringstream oss;
-    oss << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
-    oss << '.' << std::setfill('0') << std::setw(3) << ms.count();
-
-    // 使用fmt库格式化消息
-    std::string message = fmt::vformat(fmt, fmt::make_format_args(args...));
-
-    // 使用ANSI颜色代码：绿色表示信息
-    fprintf(stdout, "[%s] [\033[0;32minfo\033[0m] %s\n", oss.str().c_str(), message.c_str());
+    if (log_enabled(LogLevel::Info)) {
+        detail::log_enqueue(LogLevel::Info, fmt, fmt::make_format_args(args...));
+    }
 }
 
 // 清理字符串值，去除引号和换行符，并处理转义序列
 std::string clean_string_value(const std::string &value);
 
+// 按waybar的规则去掉外层引号并展开转义序列（\n、\t、\uXXXX等），
+// 遇到非法转义时抛出std::invalid_argument
+std::string parse_escape_sequences(std::string_view input);
+
 // 使用std::variant支持混合类型的参数值
 using format_arg = std::variant<int, double, std::string>;
 
@@ -82,10 +93,213 @@ using format_arg = std::variant<int, double, std::string>;
 // 例如: format_string("Power: {value:.2f}W, Count: {count:>3}", {{"value", 12.3456}, {"count", 42}})
 std::string format_string(const std::string &format_str, const std::vector<std::pair<std::string, format_arg>> &args);
 
+// 预编译的格式模板
+// 在加载配置时把格式字符串解析为"原样文本/占位符"操作序列，
+// 占位符名称在编译时解析为参数下标，
+// 渲染时按下标直接取值，不再进行字符串键查找，也不再重复解析格式字符串
+// 例如: auto tpl = FormatTemplate::compile("{icon} {usage:>3}%", {"icon", "usage"});
+//       tpl.render({std::string("󰾆"), 42}) -> "󰾆  42%"
+class FormatTemplate {
+  public:
+    FormatTemplate() = default;
+
+    // 编译格式字符串，names为占位符名称表（下标即参数位置）
+    // 遇到未知占位符或语法错误时抛出std::invalid_argument
+    static FormatTemplate compile(const std::string &format_str, const std::vector<std::string> &names);
+
+    // 构造只包含原样文本的模板（编译失败时的回退）
+    static FormatTemplate literal(const std::string &text);
+
+    // 按参数下标渲染，args的顺序必须与编译时的names一致
+    std::string render(const std::vector<format_arg> &args) const;
+
+    // 原始格式字符串
+    const std::string &source() const {
+        return source_;
+    }
+
+    // 引用到的参数（按参数下标的位掩码），下标超过63的参数总是视为已引用
+    uint64_t used_args() const {
+        return used_args_;
+    }
+
+  private:
+    // 占位符的格式说明，仅处理常用的 [[fill]align][width][.precision][type] 子集
+    struct Spec {
+        std::string fill = " ";
+        char align = '\0'; // '<' '>' '^'，'\0'表示按类型默认对齐
+        size_t width = 0;
+        int precision = -1;
+        char type = '\0';
+        bool native = true;   // false表示超出支持的子集，交给fmt处理
+        std::string fallback; // "{:spec}"，用于fmt回退
+    };
+
+    struct Op {
+        bool is_literal = true;
+        std::string text; // 原样文本
+        size_t arg = 0;   // 参数下标
+        bool has_spec = false;
+        Spec spec;
+    };
+
+    static Spec parse_spec(std::string_view spec);
+    static void append_arg(std::string &out, const Op &op, const format_arg &value);
+
+    std::string source_;
+    std::vector<Op> ops_;
+    uint64_t used_args_ = 0;
+};
+
+// 状态/图标/格式键的内部ID，在解析配置时分配，热路径上只做数组下标访问
+using KeyId = uint16_t;
+
+// 表示"没有匹配的状态"，名称为空字符串，图标和格式回退到default
+inline constexpr KeyId KEY_NONE = 0xFFFF;
+
+// 内置键，ID固定且与builtin_key_names的下标一致
+enum BuiltinKey : KeyId {
+    KEY_DEFAULT,
+    KEY_WARNING,
+    KEY_CRITICAL,
+    KEY_ALT,
+    KEY_DISCONNECTED,
+    KEY_WIRED,
+    KEY_WIRELESS,
+    KEY_WIRELESS_1,
+    KEY_WIRELESS_2,
+    KEY_WIRELESS_3,
+    KEY_WIRELESS_4,
+    KEY_WIRELESS_5,
+    BUILTIN_KEY_COUNT
+};
+
+inline constexpr std::array<std::string_view, BUILTIN_KEY_COUNT> builtin_key_names = {
+    "default", "warning",    "critical",   "alt",        "disconnected", "wired",
+    "wireless", "wireless-1", "wireless-2", "wireless-3", "wireless-4",   "wireless-5"
+};
+
+namespace detail {
+
+constexpr uint32_t key_hash(std::string_view name, uint32_t seed) {
+    // FNV-1a
+    uint32_t hash = 2166136261u ^ seed;
+    for (char c : name) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+inline constexpr size_t BUILTIN_KEY_TABLE_SIZE = 32;
+
+// 编译期搜索一个使所有内置键互不冲突的种子
+constexpr uint32_t find_builtin_key_seed() {
+    for (uint32_t seed = 0; seed < 100000; ++seed) {
+        std::array<bool, BUILTIN_KEY_TABLE_SIZE> used{};
+        bool ok = true;
+        for (auto name : builtin_key_names) {
+            size_t slot = key_hash(name, seed) % BUILTIN_KEY_TABLE_SIZE;
+            if (used[slot]) {
+                ok = false;
+                break;
+            }
+            used[slot] = true;
+        }
+        if (ok) {
+            return seed;
+        }
+    }
+    throw "no perfect hash seed for builtin keys";
+}
+
+inline constexpr uint32_t BUILTIN_KEY_SEED = find_builtin_key_seed();
+
+constexpr std::array<KeyId, BUILTIN_KEY_TABLE_SIZE> build_builtin_key_table() {
+    std::array<KeyId, BUILTIN_KEY_TABLE_SIZE> table{};
+    table.fill(KEY_NONE);
+    for (size_t i = 0; i < builtin_key_names.size(); ++i) {
+        table[key_hash(builtin_key_names[i], BUILTIN_KEY_SEED) % BUILTIN_KEY_TABLE_SIZE] = static_cast<KeyId>(i);
+    }
+    return table;
+}
+
+inline constexpr auto BUILTIN_KEY_TABLE = build_builtin_key_table();
+
+} // namespace detail
+
+// 通过编译期完美哈希查找内置键，不是内置键时返回KEY_NONE
+constexpr KeyId find_builtin_key(std::string_view name) {
+    KeyId id = detail::BUILTIN_KEY_TABLE[detail::key_hash(name, detail::BUILTIN_KEY_SEED) %
+                                         detail::BUILTIN_KEY_TABLE_SIZE];
+    return id != KEY_NONE && builtin_key_names[id] == name ? id : KEY_NONE;
+}
+
+static_assert(find_builtin_key("wireless-3") == KEY_WIRELESS_3);
+static_assert(find_builtin_key("disconnected") == KEY_DISCONNECTED);
+static_assert(find_builtin_key("unknown") == KEY_NONE);
+
+// 键表：把状态名称驻留为小整数ID，内置键使用固定ID，其余键按出现顺序追加
+// 只在解析配置时写入，之后只读
+class KeyTable {
+  public:
+    KeyTable() {
+        for (auto name : builtin_key_names) {
+            names_.emplace_back(name);
+        }
+    }
+
+    KeyId intern(std::string_view name) {
+        KeyId id = find(name);
+        if (id != KEY_NONE) {
+            return id;
+        }
+        id = static_cast<KeyId>(names_.size());
+        names_.emplace_back(name);
+        custom_.emplace(std::string(name), id);
+        return id;
+    }
+
+    KeyId find(std::string_view name) const {
+        KeyId id = find_builtin_key(name);
+        if (id != KEY_NONE) {
+            return id;
+        }
+        auto it = custom_.find(std::string(name));
+        return it != custom_.end() ? it->second : KEY_NONE;
+    }
+
+    const std::string &name(KeyId id) const {
+        static const std::string empty;
+        return id < names_.size() ? names_[id] : empty;
+    }
+
+    size_t size() const {
+        return names_.size();
+    }
+
+  private:
+    std::vector<std::string> names_;
+    std::unordered_map<std::string, KeyId> custom_;
+};
+
 // 格式化数字，确保总长度为指定字符数（默认4字符）
 // 例如: format_number(75.5) -> "75.5", format_number(5.25) -> "5.25", format_number(100.0) -> "100"
 std::string format_number(double value, int total_length = 4);
 
+// format_number的无分配版本：使用std::to_chars写入调用者提供的缓冲区，
+// 输出与format_number完全相同
+// 返回写入的字符数（不含结尾的'\0'），out_size应至少为total_length + 1，不足时截断
+// total_length为负数时不限制宽度
+size_t format_number_to(char *out, size_t out_size, double value, int total_length = 4);
+
+// 5字符宽度的流量格式化（参考原始Waybar的pow_format5w），以1000为基数
+// 例如: pow_format5w(1536) -> "1.54K", pow_format5w(123456789) -> " 123M"
+std::string pow_format5w(uint64_t bytes);
+
+// pow_format5w的无分配版本，out_size至少为6，返回写入的字符数
+size_t pow_format5w_to(char *out, size_t out_size, uint64_t bytes);
+
 // 安全地获取配置值，如果不存在则返回默认值
 template <typename T>
 T get_config_value(
@@ -148,6 +362,514 @@ T safe_execute(std::function<T()> func, const T &default_value, const std::strin
     }
 }
 
+// 数据根目录：所有procfs/sysfs绝对路径在打开前加上这个前缀，
+// 可以用固定文件组成的目录树代替内核接口，
+// 在任何机器上重现同样的输入（例如256个CPU、多块网卡或计数器回绕）
+// 初始值取自环境变量WAYBAR_CFFI_DATA_ROOT，配置项data-root优先；为空时访问真实路径
+// 对加载了本模块库的所有实例生效
+void set_data_root(std::string root);
+std::string data_root();
+
+// 把绝对路径映射到数据根目录下；相对路径以及没有设置数据根目录时原样返回
+// 例如: 数据根目录为/tmp/fixture时，data_path("/proc/stat") -> "/tmp/fixture/proc/stat"
+std::string data_path(std::string_view path);
+
+// 采样轨迹：把每次读取的原始内容连同单调时钟时间戳追加到二进制文件，
+// 或者从这样的文件回放。记录模式下SysfsReader（包括SampleBatch）的每次读取都写入轨迹；
+// 回放模式下读取不再访问文件，而是按顺序返回该路径记录的内容，
+// 时间戳也取记录的值，因此可以不等待地全速回放，离线重现采样时的异常
+// 由环境变量WAYBAR_CFFI_TRACE_RECORD/WAYBAR_CFFI_TRACE_REPLAY或配置项trace-record/trace-replay开启，
+// 对加载了本模块库的所有实例生效；同时设置时回放优先
+// 文件格式（本机字节序）：8字节魔数"WBCTRACE"、uint32版本、uint32保留，之后是记录序列：
+//   路径记录：uint8 1、uint32 路径ID、uint32 长度、路径
+//   读取记录：uint8 2、uint32 路径ID、int64 时间戳（纳秒）、uint32 长度、内容
+// 长度为READ_FAILED表示读取失败，没有内容
+// 路径只是记录的键，不经过SysfsReader的数据（例如网络模块的接口列表）
+// 可以用自己的键记录为一段文本
+class SampleTrace {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    // 回放时的一次读取
+    struct Record {
+        clock::time_point timestamp;
+        std::string_view data; // 指向映射的文件
+        bool ok = true;
+    };
+
+    static SampleTrace &instance();
+
+    SampleTrace(const SampleTrace &) = delete;
+    SampleTrace &operator=(const SampleTrace &) = delete;
+
+    // 开始记录到path（截断已有文件），已经在记录同一个文件时什么也不做，
+    // 失败时返回false
+    bool start_recording(const std::string &path);
+
+    // 映射并索引轨迹文件，之后的读取都从轨迹返回，失败时返回false
+    bool start_replay(const std::string &path);
+
+    // 停止记录或回放并释放文件，之后可以重新开始；
+    // 回放时只能在没有读取进行时调用，之前取出的Record随之失效
+    void stop();
+
+    bool recording() const {
+        return mode_.load(std::memory_order_acquire) == Mode::Record;
+    }
+
+    bool replaying() const {
+        return mode_.load(std::memory_order_acquire) == Mode::Replay;
+    }
+
+    // 追加一次读取，data为nullptr表示读取失败
+    void record(std::string_view path, clock::time_point timestamp, const char *data, size_t length);
+
+    // 取出path的第cursor次读取并把cursor加一，记录已经用完时返回false
+    bool replay(std::string_view path, size_t &cursor, Record &record) const;
+
+  private:
+    enum class Mode { Off, Record, Replay };
+
+    static constexpr uint8_t RECORD_PATH = 1;
+    static constexpr uint8_t RECORD_READ = 2;
+    static constexpr uint32_t READ_FAILED = UINT32_MAX;
+
+    SampleTrace();
+    ~SampleTrace();
+
+    std::atomic<Mode> mode_{Mode::Off};
+    std::mutex mutex_; // 保护记录文件和路径表
+
+    // 记录
+    std::string record_path_;
+    int record_fd_ = -1;
+    std::unordered_map<std::string, uint32_t> path_ids_;
+    std::string buffer_;
+
+    // 回放
+    std::string replay_path_;
+    void *mapping_ = nullptr;
+    size_t mapping_size_ = 0;
+    std::unordered_map<std::string_view, std::vector<Record>> replay_records_;
+};
+
+// sysfs/procfs属性读取器
+// 路径在打开时经过data_path()映射，path()和错误信息中仍是原始路径
+// 首次读取时打开文件并保留fd，
+// 之后每次用pread从偏移0重新读取（内核会重新生成内容），
+// 不再重复构造路径、ifstream和locale；设备被移除后重新出现（ENODEV/ESTALE）时自动重新打开
+// 读取失败时抛出std::runtime_error
+// 例如: SysfsReader reader("/sys/class/net/eth0/statistics/rx_bytes");
+//       uint64_t rx = reader.read_uint64();
+class SysfsReader {
+  public:
+    SysfsReader() = default;
+    explicit SysfsReader(std::string path) : path_(std::move(path)) {}
+    ~SysfsReader();
+
+    // 持有fd，只允许移动
+    SysfsReader(const SysfsReader &) = delete;
+    SysfsReader &operator=(const SysfsReader &) = delete;
+    SysfsReader(SysfsReader &&other) noexcept;
+    SysfsReader &operator=(SysfsReader &&other) noexcept;
+
+    const std::string &path() const {
+        return path_;
+    }
+
+    bool is_open() const {
+        return fd_ >= 0;
+    }
+
+    // 返回fd，未打开时先打开（失败时抛出std::runtime_error）
+    int fd() {
+        if (fd_ < 0) {
+            open();
+        }
+        return fd_;
+    }
+
+    // 关闭fd，下一次读取时重新打开
+    void close();
+
+    // 累计发起的系统调用次数（open/pread/close），用于采样统计
+    uint64_t syscalls() const {
+        return syscalls_;
+    }
+
+    // 把文件开头的至多size-1字节读入buf并以'\0'结尾，返回读取的字节数
+    size_t read(char *buf, size_t size);
+
+    // 整数快速路径：解析文件开头的十进制整数（允许前导空白）
+    uint64_t read_uint64();
+    int64_t read_int64();
+
+    // 回放轨迹时最近一次读取记录的时间
+    SampleTrace::clock::time_point replayed_at() const {
+        return replayed_at_;
+    }
+
+  private:
+    void open();
+    size_t read_file(char *buf, size_t size);
+    size_t replay(char *buf, size_t size);
+
+    std::string path_;
+    int fd_ = -1;
+    uint64_t syscalls_ = 0;
+    size_t trace_cursor_ = 0; // 回放到该路径的第几次读取
+    SampleTrace::clock::time_point replayed_at_{};
+};
+
+// 采样统计：每次submit()的系统调用次数和耗时
+struct SampleStats {
+    uint64_t ticks = 0;
+    uint64_t syscalls = 0;      // 累计系统调用次数
+    uint64_t last_syscalls = 0; // 最近一次采样的系统调用次数
+    uint64_t total_latency_ns = 0;
+    uint64_t last_latency_ns = 0;
+    uint64_t max_latency_ns = 0;
+    uint64_t reads = 0;      // 累计读取的数据源个数
+    uint64_t last_reads = 0; // 最近一次采样读取的数据源个数
+};
+
+// 固定桶的对数线性直方图
+// 每个2的幂区间分为8个线性子桶，相对误差不超过12.5%；记录是一次数组递增，
+// 不分配内存
+// 计数为relaxed原子量：采样线程记录的同时主线程可以读取，
+// 读到的分位数可能缺少正在记录的那一次
+// 例如: hist.record(120); uint64_t p99 = hist.percentile(0.99);
+class LatencyHistogram {
+  public:
+    void record(uint64_t value);
+
+    // 第q分位（0-1）所在桶的上界，不超过实际最大值；没有记录时返回0
+    uint64_t percentile(double q) const;
+
+    uint64_t count() const {
+        return count_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t max() const {
+        return max_.load(std::memory_order_relaxed);
+    }
+
+    static constexpr unsigned SUB_BUCKET_BITS = 3;
+    static constexpr size_t SUB_BUCKETS = size_t(1) << SUB_BUCKET_BITS;
+    static constexpr size_t BUCKET_COUNT = SUB_BUCKETS + (64 - SUB_BUCKET_BITS) * SUB_BUCKETS;
+
+    // 值所在的桶：小于SUB_BUCKETS的值各占一个桶，UINT64_MAX落在最后一个桶
+    static size_t bucket_index(uint64_t value);
+    // 桶内的最大值，即bucket_index(v) == index的最大v
+    static uint64_t bucket_upper_bound(size_t index);
+
+  private:
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets_{};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> max_{0};
+};
+
+// 一类操作（采样、渲染、鼠标动作、刷新信号）的自身开销：
+// 耗时分布（微秒）和线程CPU时间，可以跨线程读取
+struct CostStats {
+    LatencyHistogram latency_us;
+    std::atomic<uint64_t> cpu_ns{0};      // 累计线程CPU时间
+    std::atomic<uint64_t> cpu_samples{0}; // 计入了CPU时间的次数
+
+    // 平均每次的线程CPU时间（微秒）
+    double average_cpu_us() const {
+        uint64_t samples = cpu_samples.load(std::memory_order_relaxed);
+        return samples > 0
+                   ? static_cast<double>(cpu_ns.load(std::memory_order_relaxed)) / 1000.0 / static_cast<double>(samples)
+                   : 0.0;
+    }
+};
+
+// 在作用域内计时，析构时把单调时钟耗时和CLOCK_THREAD_CPUTIME_ID的增量记入stats
+// 作用域跨越co_await时线程CPU时间会混入挂起期间主循环的其他工作，
+// 此时用measure_cpu = false只记录耗时
+// 例如: { CostScope cost(render_cost_); render(sample); }
+class CostScope {
+  public:
+    explicit CostScope(CostStats &stats, bool measure_cpu = true);
+    ~CostScope();
+
+    CostScope(const CostScope &) = delete;
+    CostScope &operator=(const CostScope &) = delete;
+
+  private:
+    CostStats &stats_;
+    bool measure_cpu_;
+    uint64_t start_ns_;
+    uint64_t start_cpu_ns_;
+};
+
+// 一次采样需要读取的文件集合
+// 模块在初始化时注册所需的文件，每次采样调用submit()一次读取全部文件：
+// pread后端逐个读取；io_uring后端把所有读取放进一次io_uring_enter提交并一起收割，
+// io_uring不可用（未编译支持或初始化失败）时自动回退到pread
+// 例如: size_t idx = batch.add("/sys/class/drm/card1/device/gpu_busy_percent");
+//       batch.submit();
+//       int64_t busy = batch.int64(idx);
+class SampleBatch {
+  public:
+    enum class Backend { Pread, IoUring };
+
+    SampleBatch();
+    ~SampleBatch();
+
+    SampleBatch(const SampleBatch &) = delete;
+    SampleBatch &operator=(const SampleBatch &) = delete;
+
+    // 解析后端名称（"pread"、"io_uring"），无法识别时返回Pread
+    static Backend parse_backend(const std::string &name);
+    static const char *backend_name(Backend backend);
+
+    // 选择后端，返回实际使用的后端
+    Backend set_backend(Backend backend);
+    Backend backend() const {
+        return backend_;
+    }
+
+    // 注册一个文件，返回其下标；buffer_size为读取缓冲区大小（含结尾的'\0'）
+    size_t add(std::string path, size_t buffer_size = 64);
+
+    // 移除所有文件
+    void clear();
+
+    size_t size() const {
+        return entries_.size();
+    }
+
+    // 禁用的文件不参与下一次采样（例如处于退避期的数据源）
+    void set_enabled(size_t index, bool enabled) {
+        entries_[index].enabled = enabled;
+    }
+
+    // 读取所有启用的文件
+    // 记录或回放采样轨迹时总是使用pread后端，每次读取都经过SysfsReader
+    void submit();
+
+    // 最近一次采样的时间，计算速率时使用；回放轨迹时为记录的时间
+    std::chrono::steady_clock::time_point sampled_at() const {
+        return sampled_at_;
+    }
+
+    // 最近一次采样的结果；该文件未读取或读取失败时抛出std::runtime_error
+    std::string_view text(size_t index) const;
+    uint64_t uint64(size_t index) const;
+    int64_t int64(size_t index) const;
+
+    const SampleStats &stats() const {
+        return stats_;
+    }
+
+    // 以info级别输出采样统计
+    void log_stats() const;
+
+  private:
+    enum class EntryState { Pending, Ok, Failed, Skipped };
+
+    struct Entry {
+        SysfsReader reader;
+        std::vector<char> buffer;
+        size_t length = 0;
+        bool enabled = true;
+        EntryState state = EntryState::Pending;
+        std::string error;
+    };
+
+    struct IoUringState;
+
+    void read_entry(Entry &entry);
+    void submit_pread();
+    bool submit_io_uring();
+    uint64_t syscall_count() const;
+
+    std::vector<Entry> entries_;
+    Backend backend_ = Backend::Pread;
+    std::unique_ptr<IoUringState> uring_;
+    uint64_t uring_syscalls_ = 0;
+    SampleStats stats_;
+    std::chrono::steady_clock::time_point sampled_at_{};
+};
+
+// 单生产者/单消费者的最新值槽（三缓冲），无锁且不分配内存
+// 生产者在write_buffer()中填好样本后publish()；消费者consume()取得最新样本，
+// 之后read_buffer()保持不变，
+// 直到下一次consume()。消费者来不及取走的旧样本会被新样本覆盖
+template <typename T> class SampleSlot {
+  public:
+    // 生产者：取得可写缓冲区
+    T &write_buffer() {
+        return buffers_[back_];
+    }
+
+    // 生产者：发布写好的缓冲区，返回true表示覆盖了消费者尚未取走的样本
+    bool publish() {
+        uint8_t previous = middle_.exchange(static_cast<uint8_t>(back_ | FRESH), std::memory_order_acq_rel);
+        back_ = previous & INDEX_MASK;
+        return (previous & FRESH) != 0;
+    }
+
+    // 消费者：有新样本时切换到新样本并返回true
+    bool consume() {
+        if ((middle_.load(std::memory_order_relaxed) & FRESH) == 0) {
+            return false;
+        }
+        uint8_t previous = middle_.exchange(front_, std::memory_order_acq_rel);
+        front_ = previous & INDEX_MASK;
+        return true;
+    }
+
+    // 消费者：最近一次consume()取得的样本
+    const T &read_buffer() const {
+        return buffers_[front_];
+    }
+
+  private:
+    static constexpr uint8_t INDEX_MASK = 0x3;
+    static constexpr uint8_t FRESH = 0x4;
+
+    std::array<T, 3> buffers_{};
+    uint8_t back_ = 0;                  // 只由生产者访问
+    uint8_t front_ = 1;                 // 只由消费者访问
+    std::atomic<uint8_t> middle_{2};    // 两者交换的中间缓冲区下标及新样本标记
+};
+
+// 按键共享的对象注册表，引用计数由std::shared_ptr维护
+// 同一模块库中用相同的键取得的是同一个对象；最后一个持有者释放后对象随之销毁，
+// 之后再获取时重新创建
+// 例如: auto sampler = SharedRegistry<CpuSampler>::acquire("/proc/stat", []() {
+//           return std::make_shared<CpuSampler>();
+//       });
+template <typename T> class SharedRegistry {
+  public:
+    // factory只在键不存在时调用，可以抛出异常
+    template <typename Factory> static std::shared_ptr<T> acquire(const std::string &key, Factory &&factory) {
+        std::lock_guard<std::mutex> lock(mutex());
+        auto &entries = registry();
+        std::erase_if(entries, [](const auto &entry) { return entry.second.expired(); });
+
+        auto it = entries.find(key);
+        if (it != entries.end()) {
+            // 其他线程可能刚刚释放了最后一个引用，此时重新创建
+            if (std::shared_ptr<T> existing = it->second.lock()) {
+                return existing;
+            }
+        }
+
+        std::shared_ptr<T> created = factory();
+        entries[key] = created;
+        return created;
+    }
+
+  private:
+    static std::mutex &mutex() {
+        static std::mutex instance;
+        return instance;
+    }
+
+    static std::unordered_map<std::string, std::weak_ptr<T>> &registry() {
+        static std::unordered_map<std::string, std::weak_ptr<T>> instance;
+        return instance;
+    }
+};
+
+// /proc/stat中cpu汇总行的时间统计（单位为jiffies）
+struct CpuStatTimes {
+    uint64_t idle = 0;  // idle + iowait
+    uint64_t total = 0; // 所有字段之和
+};
+
+// 解析/proc/stat的"cpu user nice system idle iowait irq softirq steal guest guest_nice"行
+// 字段不足10个或格式错误时返回false
+bool parse_cpu_stat_line(std::string_view line, CpuStatTimes &times);
+
+// 数据源健康状态跟踪
+// 读取失败后按指数退避推迟下一次尝试，相同的错误只记录一次，之后定期输出汇总，
+// 恢复时输出一条信息
+// 例如: SourceHealth health("GPU usage");
+//       int usage = health.attempt<int>([&]() { return read_usage(); }, 0);
+class SourceHealth {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    explicit SourceHealth(
+        std::string name, clock::duration min_backoff = std::chrono::seconds(1),
+        clock::duration max_backoff = std::chrono::seconds(60),
+        clock::duration summary_interval = std::chrono::seconds(60)
+    );
+
+    // 当前是否应该尝试读取（仍处于退避期时返回false）
+    bool should_attempt(clock::time_point now = clock::now()) const {
+        return consecutive_failures_ == 0 || now >= next_attempt_;
+    }
+
+    // 记录一次成功的读取
+    void record_success() {
+        if (consecutive_failures_ > 0) {
+            recovered();
+        }
+    }
+
+    // 记录一次失败的读取，并计算下一次重试时间
+    void record_failure(const std::string &error, clock::time_point now = clock::now());
+
+    // 执行读取函数：退避期内直接返回fallback，异常记为失败并返回fallback
+    // 与should_attempt()配合使用时传入同一个now，保证两次判断结果一致
+    template <typename T, typename Func>
+    T attempt(Func &&func, const T &fallback, clock::time_point now = clock::now()) {
+        if (!should_attempt(now)) {
+            return fallback;
+        }
+        try {
+            T value = func();
+            record_success();
+            return value;
+        } catch (const std::exception &e) {
+            record_failure(e.what(), now);
+            return fallback;
+        }
+    }
+
+    // 数据源当前是否可用
+    bool healthy() const {
+        return consecutive_failures_ == 0;
+    }
+
+    // 连续失败次数
+    uint32_t consecutive_failures() const {
+        return consecutive_failures_;
+    }
+
+    // 累计失败次数
+    uint64_t error_count() const {
+        return error_count_;
+    }
+
+    const std::string &name() const {
+        return name_;
+    }
+
+  private:
+    void recovered();
+
+    std::string name_;
+    clock::duration min_backoff_;
+    clock::duration max_backoff_;
+    clock::duration summary_interval_;
+
+    uint32_t consecutive_failures_ = 0;
+    uint64_t error_count_ = 0;
+    clock::time_point next_attempt_{};
+
+    // 错误去重：最近一条已输出的错误、此后被合并的次数和上次汇总时间
+    std::string last_error_;
+    uint64_t suppressed_ = 0;
+    clock::time_point last_report_{};
+};
+
 } // namespace waybar::cffi::common
 
 #endif // WAYBAR_CFFI_COMMON_HPP
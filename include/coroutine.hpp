@@ -0,0 +1,318 @@
+#ifndef WAYBAR_CFFI_COROUTINE_HPP
+#define WAYBAR_CFFI_COROUTINE_HPP
+
+#include <glib.h>
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace waybar::cffi::common {
+
+// 与GLib主循环集成的协程运行时
+// 模块可以把一串阻塞步骤写成顺序代码，在co_await处挂起而不是阻塞状态栏线程：
+//   Task<Sample> collect_async() {
+//       auto addrs = co_await offload([] { return read_addresses(); }); // 在后台线程执行
+//       co_await wait_fd(fd, G_IO_IN);                                  // 等待fd可读
+//       co_await sleep_for(std::chrono::milliseconds(50));              // 定时器
+//       co_return build_sample(addrs);
+//   }
+// 协程总是在主线程（默认主上下文）中恢复，挂起点之间的代码可以访问GTK和模块状态
+// 销毁Task会销毁挂起的协程帧：等待中的GSource被移除，后台任务运行中时等待它结束
+
+template <typename T> class Task;
+
+namespace detail {
+
+// 协程结束时返回等待者；没有等待者时保持挂起，由Task负责销毁
+struct FinalAwaiter {
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    template <typename Promise> std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+        std::coroutine_handle<> continuation = handle.promise().continuation;
+        return continuation ? continuation : std::noop_coroutine();
+    }
+
+    void await_resume() const noexcept {}
+};
+
+struct PromiseBase {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr exception;
+
+    std::suspend_always initial_suspend() const noexcept {
+        return {};
+    }
+
+    FinalAwaiter final_suspend() const noexcept {
+        return {};
+    }
+
+    void unhandled_exception() noexcept {
+        exception = std::current_exception();
+    }
+};
+
+template <typename T> struct Promise : PromiseBase {
+    std::optional<T> value;
+
+    Task<T> get_return_object() noexcept;
+
+    template <typename U> void return_value(U &&result) {
+        value.emplace(std::forward<U>(result));
+    }
+
+    T take() {
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+        return std::move(*value);
+    }
+};
+
+template <> struct Promise<void> : PromiseBase {
+    Task<void> get_return_object() noexcept;
+
+    void return_void() const noexcept {}
+
+    void take() const {
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+};
+
+// 后台任务的共享状态：工作线程执行job后在主上下文中恢复handle
+struct OffloadState {
+    std::function<void()> job;
+    std::coroutine_handle<> handle;
+    std::atomic<bool> done{false};
+    bool cancelled = false; // 只在主线程中访问
+};
+
+// 把任务交给后台线程
+void offload_submit(std::shared_ptr<OffloadState> state);
+
+// 阻塞等待任务执行完毕
+void offload_wait(OffloadState &state);
+
+} // namespace detail
+
+// 惰性启动的协程任务：co_await时开始执行并在完成后恢复等待者，
+// 或者用start()从非协程代码启动
+// Task拥有协程帧，析构时销毁尚未完成的协程
+template <typename T = void> class Task {
+  public:
+    using promise_type = detail::Promise<T>;
+
+    Task() = default;
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+    Task(Task &&other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+    Task &operator=(Task &&other) noexcept {
+        if (this != &other) {
+            reset();
+            handle_ = std::exchange(other.handle_, {});
+        }
+        return *this;
+    }
+
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+    ~Task() {
+        reset();
+    }
+
+    bool valid() const {
+        return bool(handle_);
+    }
+
+    // 协程已经运行结束（包括以异常结束）
+    bool done() const {
+        return handle_ && handle_.done();
+    }
+
+    // 从非协程代码启动，运行到第一个挂起点返回
+    void start() {
+        handle_.resume();
+    }
+
+    // 销毁协程帧
+    void reset() {
+        if (handle_) {
+            std::exchange(handle_, {}).destroy();
+        }
+    }
+
+    auto operator co_await() && noexcept {
+        struct Awaiter {
+            std::coroutine_handle<promise_type> handle;
+
+            bool await_ready() const noexcept {
+                return false;
+            }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                handle.promise().continuation = awaiting;
+                return handle;
+            }
+
+            T await_resume() {
+                return handle.promise().take();
+            }
+        };
+        return Awaiter{handle_};
+    }
+
+  private:
+    std::coroutine_handle<promise_type> handle_;
+};
+
+namespace detail {
+
+template <typename T> Task<T> Promise<T>::get_return_object() noexcept {
+    return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline Task<void> Promise<void>::get_return_object() noexcept {
+    return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+} // namespace detail
+
+// 等待fd就绪，返回实际发生的条件
+class FdAwaiter {
+  public:
+    FdAwaiter(int fd, GIOCondition condition) : fd_(fd), condition_(condition) {}
+    ~FdAwaiter();
+
+    FdAwaiter(const FdAwaiter &) = delete;
+    FdAwaiter &operator=(const FdAwaiter &) = delete;
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle);
+
+    GIOCondition await_resume() const noexcept {
+        return revents_;
+    }
+
+  private:
+    static gboolean dispatch(gint fd, GIOCondition condition, gpointer user_data);
+
+    int fd_;
+    GIOCondition condition_;
+    GIOCondition revents_ = GIOCondition(0);
+    guint source_id_ = 0;
+    std::coroutine_handle<> handle_;
+};
+
+// 等待指定的时间
+class SleepAwaiter {
+  public:
+    explicit SleepAwaiter(std::chrono::milliseconds duration) : duration_(duration) {}
+    ~SleepAwaiter();
+
+    SleepAwaiter(const SleepAwaiter &) = delete;
+    SleepAwaiter &operator=(const SleepAwaiter &) = delete;
+
+    bool await_ready() const noexcept {
+        return duration_.count() <= 0;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle);
+
+    void await_resume() const noexcept {}
+
+  private:
+    static gboolean dispatch(gpointer user_data);
+
+    std::chrono::milliseconds duration_;
+    guint source_id_ = 0;
+    std::coroutine_handle<> handle_;
+};
+
+// 在后台线程中执行func，
+// 完成后回到主线程恢复协程并返回func的结果（或重新抛出它的异常）
+// 所有模块共用一个后台线程，任务按提交顺序执行；func可以引用协程帧中的局部变量，
+// 协程在等待期间被销毁时会阻塞到func结束
+template <typename Func> class OffloadAwaiter {
+  public:
+    using Result = std::invoke_result_t<Func &>;
+
+    explicit OffloadAwaiter(Func func) : func_(std::move(func)) {}
+
+    ~OffloadAwaiter() {
+        if (state_) {
+            state_->cancelled = true;
+            detail::offload_wait(*state_);
+        }
+    }
+
+    OffloadAwaiter(const OffloadAwaiter &) = delete;
+    OffloadAwaiter &operator=(const OffloadAwaiter &) = delete;
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        state_ = std::make_shared<detail::OffloadState>();
+        state_->handle = handle;
+        state_->job = [this]() {
+            try {
+                if constexpr (std::is_void_v<Result>) {
+                    func_();
+                } else {
+                    result_.emplace(func_());
+                }
+            } catch (...) {
+                exception_ = std::current_exception();
+            }
+        };
+        detail::offload_submit(state_);
+    }
+
+    Result await_resume() {
+        if (exception_) {
+            std::rethrow_exception(exception_);
+        }
+        if constexpr (!std::is_void_v<Result>) {
+            return std::move(*result_);
+        }
+    }
+
+  private:
+    using Storage = std::conditional_t<std::is_void_v<Result>, bool, Result>;
+
+    Func func_;
+    std::shared_ptr<detail::OffloadState> state_;
+    std::optional<Storage> result_;
+    std::exception_ptr exception_;
+};
+
+inline FdAwaiter wait_fd(int fd, GIOCondition condition) {
+    return FdAwaiter(fd, condition);
+}
+
+inline SleepAwaiter sleep_for(std::chrono::milliseconds duration) {
+    return SleepAwaiter(duration);
+}
+
+template <typename Func> OffloadAwaiter<std::decay_t<Func>> offload(Func &&func) {
+    return OffloadAwaiter<std::decay_t<Func>>(std::forward<Func>(func));
+}
+
+} // namespace waybar::cffi::common
+
+#endif // WAYBAR_CFFI_COROUTINE_HPP
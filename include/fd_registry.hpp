@@ -0,0 +1,77 @@
+#ifndef WAYBAR_CFFI_FD_REGISTRY_HPP
+#define WAYBAR_CFFI_FD_REGISTRY_HPP
+
+#include <glib.h>
+#include <cstdint>
+#include <functional>
+#include <map>
+
+namespace waybar::cffi::common {
+
+// 共享的fd事件源
+// 所有注册的fd加入同一个epoll实例，GLib主循环只轮询epoll fd；
+// epoll fd可读时一次epoll_wait取出所有就绪的fd，
+// 在主线程中调用对应的回调。用于内核可以主动推送的数据：
+// netlink、PSI触发器、inotify、uevent、timerfd等
+// 同一个fd可以注册多次（例如共享采样器的事件fd被多个模块实例监听），
+// 就绪时依次调用每个回调
+class FdRegistry {
+  public:
+    // events为实际就绪的epoll事件
+    using Callback = std::function<void(uint32_t events)>;
+
+    // 每个模块库一个实例，同类模块的所有实例共享
+    static FdRegistry &instance();
+
+    FdRegistry(const FdRegistry &) = delete;
+    FdRegistry &operator=(const FdRegistry &) = delete;
+
+    // 监听fd上的epoll事件（EPOLLIN、EPOLLPRI等，水平触发），返回监听ID；失败时返回0
+    // 回调负责读走数据，否则下一次主循环迭代会再次触发
+    guint add(int fd, uint32_t events, Callback callback);
+
+    // 移除监听，可以在回调中调用；fd由调用者关闭，关闭前必须先移除
+    void remove(guint id);
+
+    // epoll fd就绪的次数
+    uint64_t wakeups() const {
+        return wakeups_;
+    }
+
+    // 回调被调用的总次数
+    uint64_t dispatches() const {
+        return dispatches_;
+    }
+
+    size_t watch_count() const {
+        return watches_.size();
+    }
+
+  private:
+    struct Watch {
+        int fd;
+        uint32_t events;
+        Callback callback;
+        bool removed = false; // 在分发过程中被移除，分发结束后清理
+    };
+
+    FdRegistry() = default;
+    ~FdRegistry();
+
+    // 按该fd所有监听的事件并集更新epoll，没有监听时移出epoll；epoll不接受该fd时返回false
+    bool update_interest(int fd);
+    void dispatch();
+    static gboolean source_dispatch(GSource *source, GSourceFunc callback, gpointer user_data);
+
+    int epoll_fd_ = -1;
+    GSource *source_ = nullptr;
+    std::map<guint, Watch> watches_;
+    guint next_id_ = 1;
+    bool dispatching_ = false;
+    uint64_t wakeups_ = 0;
+    uint64_t dispatches_ = 0;
+};
+
+} // namespace waybar::cffi::common
+
+#endif // WAYBAR_CFFI_FD_REGISTRY_HPP
@@ -4,14 +4,27 @@
 #include <gdk/gdk.h>
 #include <glib.h>
 #include <gtk/gtk.h>
+#include <climits>
 #include <cstdint>
 #include <string>
 #include <functional>
+#include <map>
 #include <unordered_map>
+#include <vector>
+#include <algorithm>
 #include <memory>
 #include <cstdlib>
+#include <csignal>
 #include <common.hpp>
+#include <coroutine.hpp>
+#include <fd_registry.hpp>
+#include <tick_scheduler.hpp>
 #include <concepts>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <thread>
 
 // 如果系统安装了nlohmann/json，使用系统版本
 #ifdef __has_include
@@ -59,6 +72,11 @@ void wbcffi_refresh(void *instance, int signal);
 
 // 获取GTK组件
 GtkWidget *wbcffi_get_widget(void *instance);
+
+// 扩展接口（waybar不使用）：无界面宿主读取tooltip文本，
+// 以及不经过定时器立即采集一次（不渲染）
+size_t wbcffi_host_tooltip(void *instance, char *buf, size_t size);
+void wbcffi_host_tick(void *instance);
 }
 
 namespace waybar::cffi::base {
@@ -66,14 +84,36 @@ namespace waybar::cffi::base {
 // 通用状态枚举
 enum class ModuleState { DEFAULT, WARNING, CRITICAL };
 
+// 渲染统计：实际写入GTK的次数与因内容未变化而跳过的次数
+struct RenderStats {
+    uint64_t applied = 0;
+    uint64_t skipped = 0;
+};
+
+// 调试占位符：模块自身开销的统计，只能在format-tooltip中使用，
+// 按format_args之后的下标编译
+// _update_*是采集一次样本的开销（在实际采样的线程中测量），_render_*是主线程渲染的开销
+// 顺序与ModuleBase::debug_format_values()一致
+inline const std::vector<std::string> DEBUG_FORMAT_ARGS = {
+    "_update_us_p50", "_update_us_p99", "_update_us_max", "_update_cpu_us", "_update_count", "_sources_per_tick",
+    "_render_us_p99", "_render_us_max", "_action_us_p99", "_action_us_max", "_refresh_us_p99", "_refresh_us_max",
+};
+
 // 通用配置基类 - 使用模板参数支持不同类型的阈值
 template <typename ThresholdType = int>
     requires std::integral<ThresholdType> || std::floating_point<ThresholdType>
 struct ModuleConfigBase {
     std::unordered_map<std::string, std::string> config_map;
 
-    int interval = 1;
+    uint32_t interval_ms = 1000; // 刷新间隔（毫秒）
+    bool adaptive_interval = false; // 显示内容持续不变时逐步延长刷新间隔
+    uint32_t max_interval_ms = 0;   // 自适应间隔的上限（毫秒），由parse_interval()计算
     bool tooltip = true; // 默认启用tooltip
+    std::string io_backend = "pread";      // 采样后端："pread"或"io_uring"
+    int stats_signal = 0;                  // 收到SIGRTMIN+stats_signal时输出采样统计，0表示禁用
+    bool sampling_thread = false;          // 在独立的工作线程中采样，主线程只负责渲染
+    std::string update_mode = "immediate"; // 写入GTK的时机："immediate"或"frame-clock"
+    int action_coalesce_ms = 0;            // 同一动作的后续触发在窗口内合并执行，0表示不合并
     std::string format_tooltip;
     std::unordered_map<std::string, std::string> icons;
     std::unordered_map<std::string, std::string> formats;
@@ -82,6 +122,37 @@ struct ModuleConfigBase {
     // 鼠标事件动作配置
     std::unordered_map<std::string, std::string> actions; // 存储鼠标事件对应的动作
 
+    // 格式化参数名称，下标即参数位置（子类在构造函数中设置，
+    // render()中按相同顺序提供参数值）
+    std::vector<std::string> format_args;
+
+    // 可选采集项：占位符名称 -> 为它提供数据的采集项（位掩码，
+    // 含义由模块的采样器定义）
+    // 子类在构造函数中设置；没有任何格式引用的占位符对应的采集项不会运行
+    std::vector<std::pair<std::string, uint32_t>> collector_args;
+
+    // 以下内容由prepare()在解析配置后生成，之后只读
+    // 状态/图标/格式键驻留后的ID表
+    common::KeyTable keys;
+
+    // 按键ID索引的图标和预编译格式，已解析好回退到default的规则
+    std::vector<std::string> icon_by_key;
+    std::vector<common::FormatTemplate> format_by_key;
+    common::FormatTemplate compiled_tooltip;
+
+    // 所有格式和（启用时的）tooltip引用的参数，按format_args下标的位掩码
+    uint64_t used_args = 0;
+
+    // tooltip引用了调试占位符，渲染时需要追加DEBUG_FORMAT_ARGS对应的值
+    bool tooltip_uses_debug_args = false;
+
+    // 被引用的占位符需要的采集项
+    uint32_t required_collectors = 0;
+
+    // 预排序的阈值表
+    std::vector<std::pair<common::KeyId, ThresholdType>> states_desc; // 阈值从大到小，用于"大于等于"判断
+    std::vector<std::pair<common::KeyId, ThresholdType>> states_asc;  // 阈值从小到大，用于lesser判断
+
     // 构造函数，初始化默认状态和格式
     ModuleConfigBase() {
         states["warning"] = static_cast<ThresholdType>(20);
@@ -96,8 +167,40 @@ struct ModuleConfigBase {
 
         // 使用公共工具加载配置
         tooltip = common::get_config_value<bool>(config_map, "tooltip", tooltip);
-        interval = common::get_config_value<int>(config_map, "interval", interval);
+        parse_interval();
         format_tooltip = common::get_config_value<std::string>(config_map, "format-tooltip", format_tooltip);
+        io_backend = common::get_config_value<std::string>(config_map, "io-backend", io_backend);
+        stats_signal = common::get_config_value<int>(config_map, "stats-signal", stats_signal);
+        sampling_thread = common::get_config_value<bool>(config_map, "sampling-thread", sampling_thread);
+        update_mode = common::get_config_value<std::string>(config_map, "update-mode", update_mode);
+        if (update_mode != "immediate" && update_mode != "frame-clock") {
+            common::log_warning("Unknown update-mode '{}', using 'immediate'", update_mode);
+            update_mode = "immediate";
+        }
+        action_coalesce_ms = std::max(
+            common::get_config_value<int>(config_map, "action-coalesce-ms", action_coalesce_ms), 0
+        );
+
+        // 日志级别对同一模块库的所有实例生效
+        auto log_level_value = config_map.find("log-level");
+        if (log_level_value != config_map.end()) {
+            common::set_log_level(common::parse_log_level(log_level_value->second, common::LogLevel::Info));
+        }
+
+        // 数据根目录同样对所有实例生效，覆盖环境变量WAYBAR_CFFI_DATA_ROOT
+        auto data_root_value = config_map.find("data-root");
+        if (data_root_value != config_map.end()) {
+            common::set_data_root(data_root_value->second);
+        }
+
+        // 采样轨迹的记录和回放，回放优先
+        auto trace_replay_value = config_map.find("trace-replay");
+        auto trace_record_value = config_map.find("trace-record");
+        if (trace_replay_value != config_map.end()) {
+            common::SampleTrace::instance().start_replay(trace_replay_value->second);
+        } else if (trace_record_value != config_map.end()) {
+            common::SampleTrace::instance().start_recording(trace_record_value->second);
+        }
 
         // 解析格式配置
         auto formats_value = config_map.find("formats");
@@ -158,10 +261,284 @@ struct ModuleConfigBase {
             }
         }
     }
+
+    // 解析配置后预计算热路径使用的所有表
+    void prepare() {
+        intern_keys();
+        compile_formats();
+        build_state_tables();
+        compute_required_collectors();
+    }
+
+    // 按预排序的阈值表匹配状态，没有匹配时返回KEY_NONE
+    // lesser为false时返回阈值不大于value的最大阈值对应的状态，
+    // 为true时返回阈值不小于value的最小阈值对应的状态
+    common::KeyId match_state(double value, bool lesser) const {
+        const auto &sorted_states = lesser ? states_asc : states_desc;
+        for (const auto &[id, threshold] : sorted_states) {
+            auto rhs = static_cast<double>(threshold);
+            if (lesser ? value <= rhs : value >= rhs) {
+                return id;
+            }
+        }
+        return common::KEY_NONE;
+    }
+
+    // 是否有格式（或启用的tooltip）引用了名为name的占位符
+    bool uses_arg(std::string_view name) const {
+        auto it = std::find(format_args.begin(), format_args.end(), name);
+        if (it == format_args.end()) {
+            return false;
+        }
+        size_t index = static_cast<size_t>(it - format_args.begin());
+        return index >= 64 || (used_args >> index) & 1;
+    }
+
+    // 按键ID获取图标/格式，KEY_NONE等未知ID回退到default
+    const std::string &icon_for(common::KeyId id) const {
+        return id < icon_by_key.size() ? icon_by_key[id] : icon_by_key[common::KEY_DEFAULT];
+    }
+
+    const common::FormatTemplate &format_for(common::KeyId id) const {
+        return id < format_by_key.size() ? format_by_key[id] : format_by_key[common::KEY_DEFAULT];
+    }
+
+  private:
+    // 最小刷新间隔，避免配置错误时占满主线程
+    static constexpr uint32_t MIN_INTERVAL_MS = 10;
+
+    // 解析刷新间隔：interval以秒为单位，可以是小数（例如0.25）；interval-ms以毫秒为单位，
+    // 优先级更高
+    void parse_interval() {
+        double interval_ms_value = static_cast<double>(interval_ms);
+        if (config_map.count("interval-ms") > 0) {
+            interval_ms_value = common::get_config_value<double>(config_map, "interval-ms", interval_ms_value);
+        } else if (config_map.count("interval") > 0) {
+            double interval_s = common::get_config_value<double>(config_map, "interval", interval_ms / 1000.0);
+            interval_ms_value = interval_s * 1000.0;
+        }
+
+        if (!(interval_ms_value >= MIN_INTERVAL_MS)) {
+            common::log_warning("Interval {}ms is too small, using {}ms", interval_ms_value, MIN_INTERVAL_MS);
+            interval_ms_value = MIN_INTERVAL_MS;
+        }
+        interval_ms = static_cast<uint32_t>(std::min(std::round(interval_ms_value), double(UINT32_MAX)));
+
+        // 自适应间隔的上限以秒为单位，默认为基础间隔的8倍，不小于基础间隔
+        adaptive_interval = common::get_config_value<bool>(config_map, "adaptive-interval", adaptive_interval);
+        double max_interval_ms_value = static_cast<double>(interval_ms) * 8.0;
+        if (config_map.count("max-interval") > 0) {
+            double max_interval_s = common::get_config_value<double>(config_map, "max-interval", 0.0);
+            max_interval_ms_value = max_interval_s * 1000.0;
+        }
+        max_interval_ms_value = std::clamp(max_interval_ms_value, static_cast<double>(interval_ms), double(UINT32_MAX));
+        max_interval_ms = static_cast<uint32_t>(std::round(max_interval_ms_value));
+    }
+
+    // 把icons、formats、states中出现的所有键驻留为ID，并解析图标
+    void intern_keys() {
+        for (const auto &entry : icons) {
+            keys.intern(entry.first);
+        }
+        for (const auto &entry : formats) {
+            keys.intern(entry.first);
+        }
+        for (const auto &entry : states) {
+            keys.intern(entry.first);
+        }
+
+        // 找不到对应状态的图标时使用默认图标，最后的备用方案是空字符串
+        auto default_icon = icons.find("default");
+        icon_by_key.assign(keys.size(), default_icon != icons.end() ? default_icon->second : std::string());
+        for (const auto &[name, icon] : icons) {
+            icon_by_key[keys.find(name)] = icon;
+        }
+    }
+
+    // 预编译所有格式模板，未知占位符在加载时报错并回退为原样文本
+    void compile_formats() {
+        auto compile = [this](const std::string &format_str, const std::vector<std::string> &names) {
+            try {
+                return common::FormatTemplate::compile(format_str, names);
+            } catch (const std::exception &e) {
+                common::log_error("Invalid format '{}': {}", format_str, e.what());
+                return common::FormatTemplate::literal(format_str);
+            }
+        };
+
+        // 找不到对应状态的格式时使用默认格式，最后的备用方案是"{}"
+        auto default_it = formats.find("default");
+        common::FormatTemplate fallback =
+            compile(default_it != formats.end() ? default_it->second : "{}", format_args);
+        format_by_key.assign(keys.size(), fallback);
+        for (const auto &[name, format_str] : formats) {
+            format_by_key[keys.find(name)] = compile(format_str, format_args);
+        }
+
+        // format-tooltip为空时回退到默认格式；只有tooltip可以引用调试占位符
+        if (format_tooltip.empty()) {
+            compiled_tooltip = fallback;
+        } else {
+            std::vector<std::string> tooltip_names = format_args;
+            tooltip_names.insert(tooltip_names.end(), DEBUG_FORMAT_ARGS.begin(), DEBUG_FORMAT_ARGS.end());
+            compiled_tooltip = compile(format_tooltip, tooltip_names);
+        }
+        uint64_t format_arg_mask = format_args.size() >= 64 ? ~uint64_t(0) : (uint64_t(1) << format_args.size()) - 1;
+        tooltip_uses_debug_args = (compiled_tooltip.used_args() & ~format_arg_mask) != 0;
+
+        // 汇总所有格式引用的参数，供按需采集使用
+        used_args = 0;
+        for (const common::FormatTemplate &format : format_by_key) {
+            used_args |= format.used_args();
+        }
+        if (tooltip) {
+            used_args |= compiled_tooltip.used_args() & format_arg_mask;
+        }
+    }
+
+    // 根据被引用的占位符确定需要运行的采集项
+    void compute_required_collectors() {
+        required_collectors = 0;
+        for (const auto &[name, collectors] : collector_args) {
+            if (uses_arg(name)) {
+                required_collectors |= collectors;
+            }
+        }
+    }
+
+    // 预先把states排序为两种顺序，get_state()不再每次复制和排序
+    void build_state_tables() {
+        states_desc.clear();
+        for (const auto &[name, threshold] : states) {
+            states_desc.emplace_back(keys.find(name), threshold);
+        }
+        states_asc = states_desc;
+
+        // 阈值相同时按名称排序，保证结果稳定
+        auto by_name = [this](common::KeyId a, common::KeyId b) { return keys.name(a) < keys.name(b); };
+        std::sort(states_desc.begin(), states_desc.end(), [&](const auto &a, const auto &b) {
+            return a.second != b.second ? a.second > b.second : by_name(a.first, b.first);
+        });
+        std::sort(states_asc.begin(), states_asc.end(), [&](const auto &a, const auto &b) {
+            return a.second != b.second ? a.second < b.second : by_name(a.first, b.first);
+        });
+    }
+};
+
+// 在同类模块的多个实例之间共享的采样器
+// Waybar为每个输出创建一个模块实例，
+// 订阅同一数据源的实例通过common::SharedRegistry共享同一个采样器，
+// 数据源在每个周期只读取一次，计算增量所需的上一次读数也只保存一份
+// 子类在collect()中采集数据；sample()可以在多个线程中同时调用
+template <typename SampleType> class SharedSampler {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    explicit SharedSampler(common::SampleBatch::Backend backend) {
+        sample_batch_.set_backend(backend);
+    }
+    virtual ~SharedSampler() = default;
+
+    SharedSampler(const SharedSampler &) = delete;
+    SharedSampler &operator=(const SharedSampler &) = delete;
+
+    // 返回采集时间距今小于max_age的样本，没有时重新采集
+    // 同一周期内先到的实例负责采集，其余实例直接取用缓存的样本
+    SampleType sample(clock::duration max_age) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++requests_;
+        return sample_locked(max_age, [this]() { return collect(); });
+    }
+
+    // 异步采集使用：缓存仍然有效时返回缓存的样本
+    std::optional<SampleType> cached_sample(clock::duration max_age) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++requests_;
+        if (has_sample_ && !stale_.load(std::memory_order_acquire) && clock::now() - sampled_at_ < max_age) {
+            return cached_;
+        }
+        return std::nullopt;
+    }
+
+    // 异步采集使用：准备好输入后由func完成采集；
+    // 等待期间其他实例已经采集过时直接返回缓存
+    template <typename Func> SampleType sample_with(clock::duration max_age, Func &&func) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return sample_locked(max_age, std::forward<Func>(func));
+    }
+
+    // 数据源报告了变化（例如netlink事件），下一次请求重新采集；
+    // 可以在任意线程中调用，不等待锁
+    void invalidate() {
+        stale_.store(true, std::memory_order_release);
+    }
+
+    // 按需采集：订阅的实例声明需要的可选采集项（ModuleConfigBase::required_collectors），
+    // 采样器只运行所有订阅者需要的并集；只增不减，实例销毁后不收回它声明的采集项
+    void require(uint32_t collectors) {
+        collectors_.fetch_or(collectors, std::memory_order_acq_rel);
+    }
+
+    uint32_t collectors() const {
+        return collectors_.load(std::memory_order_acquire);
+    }
+
+    // 最近一次采集读取的数据源个数；不等待锁，主线程可以在采集进行中读取
+    uint64_t last_reads() const {
+        return last_reads_.load(std::memory_order_relaxed);
+    }
+
+    // 以info级别输出采样统计，subscribers为订阅该采样器的实例数
+    void log_stats(long subscribers) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sample_batch_.log_stats();
+        common::log_info(
+            "Shared sampler: subscribers={} requests={} collections={}", subscribers, requests_, collections_
+        );
+    }
+
+  protected:
+    // 采集一次数据，调用时已持有锁
+    virtual SampleType collect() = 0;
+
+    // 采样层：子类在构造函数中注册每次采集需要读取的文件，collect()开始时统一读取
+    common::SampleBatch sample_batch_;
+
+  private:
+    template <typename Func> SampleType sample_locked(clock::duration max_age, Func &&func) {
+        clock::time_point now = clock::now();
+        bool stale = stale_.exchange(false, std::memory_order_acq_rel);
+        if (!has_sample_ || stale || now - sampled_at_ >= max_age) {
+            cached_ = func();
+            last_reads_.store(sample_batch_.stats().last_reads, std::memory_order_relaxed);
+            sampled_at_ = now;
+            has_sample_ = true;
+            ++collections_;
+        }
+        return cached_;
+    }
+
+    std::mutex mutex_;
+    SampleType cached_{};
+    clock::time_point sampled_at_;
+    bool has_sample_ = false;
+    std::atomic<bool> stale_{false};
+    std::atomic<uint32_t> collectors_{0};
+    std::atomic<uint64_t> last_reads_{0};
+    uint64_t requests_ = 0;
+    uint64_t collections_ = 0;
 };
 
 // 模块基类
-template <typename ConfigType> class ModuleBase {
+// 每次更新分为两步：sample()采集数据并生成SampleType样本，render()根据样本更新GTK组件
+// 默认两步都在GTK主线程中完成；
+// 启用sampling-thread后sample()在每个模块实例独立的工作线程中执行，
+// 样本通过SampleSlot交给主线程，
+// 再经queue_update（或空闲源）触发主线程中的rerender()完成渲染，
+// 因此缓慢的读取（例如唤醒挂起的独立显卡需要数百毫秒）不会阻塞状态栏的输入处理
+// 子类也可以重载sample_async()把采集写成协程，主线程模式下阻塞的步骤在co_await处挂起，
+// 完成后再渲染
+template <typename ConfigType, typename SampleType> class ModuleBase {
   public:
     ModuleBase(const wbcffi_init_info *init_info, const wbcffi_config_entry *config_entries, size_t config_entries_len);
     virtual ~ModuleBase();
@@ -172,10 +549,29 @@ template <typename ConfigType> class ModuleBase {
     ModuleBase(ModuleBase &&) = delete;
     ModuleBase &operator=(ModuleBase &&) = delete;
 
-    // 更新函数
-    virtual void update() = 0;
+    // 更新函数：主线程采样模式下采样并渲染（异步采集时启动一次采集，
+    // 完成后渲染）；
+    // 采样线程模式下渲染工作线程发布的最新样本
+    void update();
+
+    // 用最近一次的样本重新渲染，不采样：
+    // 格式切换、刷新信号和waybar的update回调只需要重新渲染，
+    // 不应该为此读取硬件（例如唤醒运行时挂起的独立显卡）
+    void rerender();
+
+    // 刷新信号：从缓存的样本重新渲染；收到stats-signal时额外输出统计
     virtual void refresh(int signal);
 
+    // 立即在主线程中采集一次，不使用共享采样器的缓存，
+    // 也不渲染（由之后的update()/rerender()渲染）
+    // 供无界面宿主按自己的节奏驱动模块并分别测量采样和渲染（例如全速回放轨迹）；
+    // 采样线程模式下只请求一次采样
+    void sample_now();
+
+    // 停止采样线程并销毁进行中的异步采集，
+    // 必须在派生类析构之前调用（sample()访问派生类的成员）
+    void stop_sampling();
+
     // 获取GTK组件（用于C接口）
     GtkWidget *get_widget() const {
         return event_box_;
@@ -186,6 +582,17 @@ template <typename ConfigType> class ModuleBase {
         return *config_;
     }
 
+    // 获取渲染统计
+    const RenderStats &render_stats() const {
+        return render_stats_;
+    }
+
+    // 当前样本对应的tooltip文本，tooltip被禁用时为空（tooltip平时只在显示时渲染，
+    // 供无界面宿主读取）
+    std::string tooltip_text() const {
+        return config_->tooltip ? render_tooltip() : std::string();
+    }
+
   protected:
     // 配置和状态
     std::unique_ptr<ConfigType> config_;
@@ -200,27 +607,202 @@ template <typename ConfigType> class ModuleBase {
     wbcffi_module *obj_ = nullptr;
     void (*queue_update_)(wbcffi_module *) = nullptr;
 
-    // 定时器ID
+    // 渲染层：记录最近一次要求显示的内容，只有变化时才调用GTK，避免无谓的resize/redraw
+    std::string last_label_;
+    bool label_rendered_ = false;
+    bool tooltip_enabled_ = false;
+    common::KeyId css_state_ = common::KEY_NONE;         // 要求的状态类
+    common::KeyId applied_css_state_ = common::KEY_NONE; // 当前已添加到样式上下文的状态类
+    RenderStats render_stats_;
+
+    // frame-clock模式：修改先暂存，在顶层窗口帧时钟的update阶段统一写入GTK，
+    // 同一帧内所有模块的修改只引起一次布局和重绘
+    bool frame_clock_updates_ = false;
+    GdkFrameClock *frame_clock_ = nullptr; // 已连接update信号的帧时钟（持有引用）
+    gulong frame_update_handler_ = 0;
+    bool frame_pending_ = false; // 已请求下一帧
+    bool label_staged_ = false;
+    bool css_staged_ = false;
+    bool tooltip_enabled_staged_ = false;
+
+    // 最近一次采样的格式化参数，tooltip在GTK查询时才用它渲染
+    std::vector<common::format_arg> tooltip_args_;
+    bool hovered_ = false; // 鼠标是否位于模块上（此时tooltip可能正在显示）
+
+    // 共享采样器，由子类在构造函数中通过common::SharedRegistry按数据源获取
+    std::shared_ptr<SharedSampler<SampleType>> sampler_;
+
+    // 采样结果：工作线程（或主线程）发布，主线程消费
+    common::SampleSlot<SampleType> sample_slot_;
+    bool has_sample_ = false; // 主线程是否已经取得过样本
+
+    // 采样线程及其与主线程之间的信号
+    std::thread sampling_thread_;
+    std::atomic<uint32_t> sample_requests_{0}; // 每个采样请求加一
+    std::atomic<bool> sampling_stop_{false};
+    std::atomic<bool> stats_requested_{false}; // 下一次采样后由工作线程输出统计，不在主线程等锁
+    std::atomic<bool> render_pending_{false};  // 已通知主线程渲染但尚未执行，避免重复通知
+    GSource *render_source_ = nullptr;         // 没有queue_update回调时用于唤醒主线程
+
+    // 异步采集：子类重载sample_async()后把async_sampling_设为true
+    bool async_sampling_ = false;
+    common::Task<void> async_update_; // 进行中（或已完成）的异步采集
+    bool bypass_sample_cache_ = false; // sample_now()期间不使用共享采样器的缓存
+
+    // 自身开销：耗时分布与线程CPU时间
+    // sample_cost_在实际采样的线程中记录（采样线程模式下是工作线程），
+    // 其余在主线程中记录；都可以在主线程中读取
+    common::CostStats sample_cost_;
+    common::CostStats render_cost_;
+    common::CostStats action_cost_;
+    common::CostStats refresh_cost_;
+
+    // 按DEBUG_FORMAT_ARGS的顺序给出调试占位符的值
+    std::vector<common::format_arg> debug_format_values() const;
+
+    // 以info级别输出自身开销
+    void log_cost_stats() const;
+
+    // render_source_使用的GSource，携带所属模块
+    struct RenderSource {
+        GSource source;
+        ModuleBase *module;
+    };
+
+    // 调度器任务ID
     guint timer_id_ = 0;
+
+    // 通过watch_fd注册的监听ID
+    std::vector<guint> fd_watches_;
+
+    // 可见性：不可见时暂停定时器，重新可见时立即补采一次
+    bool mapped_ = true;    // 在收到unmap之前假设组件可见
+    bool obscured_ = false; // visibility-notify报告完全被遮挡
+    bool suspended_ = false;
+
+    // 自适应间隔：当前使用的间隔，以及显示内容连续未变化的采样次数
+    uint32_t current_interval_ms_ = 0;
+    uint32_t unchanged_samples_ = 0;
+    bool label_changed_ = false; // 本次渲染是否修改了标签文本
     bool handles_button_press_ = true; // 标记子类是否重载了handle_button_press
     bool handles_scroll_ = true;       // 标记子类是否重载了handle_scroll
 
     // 内部方法
     void init_ui(const wbcffi_init_info *init_info);
     void setup_timer();
+    void remove_timer();
+
+    // 触发一次采样：采样线程模式下交给工作线程，否则立即采样并渲染
+    void tick();
+
+    // 事件驱动的数据源：fd就绪时在主线程中调用callback（参数为就绪的epoll事件），
+    // 返回监听ID，失败时返回0
+    // 回调通常读走数据后调用tick()立即刷新；模块可以只依赖事件，
+    // 也可以与定时器组合（事件加慢速轮询）
+    // stop_sampling()移除所有监听，fd由模块自己关闭
+    guint watch_fd(int fd, uint32_t events, common::FdRegistry::Callback callback);
+    void unwatch_fd(guint id);
 
-    // 获取状态对应的图标和格式
-    virtual const std::string &get_icon_for_state_name(const std::string &state_name) const;
-    virtual const std::string &get_format_for_state_name(const std::string &state_name) const;
+    // 按映射和遮挡状态暂停或恢复定时器
+    void update_visibility();
 
-    // 获取tooltip格式，如果format-tooltip为空则回退到默认格式
-    const std::string &get_tooltip_format() const;
+    // 根据本次采样是否改变了显示内容调整刷新间隔
+    void adapt_interval(bool changed);
+
+    // 显示内容连续不变多少次后延长一次间隔
+    static constexpr uint32_t ADAPTIVE_STEADY_SAMPLES = 3;
+
+    // 采样器使用的后端
+    common::SampleBatch::Backend sample_backend() const {
+        return common::SampleBatch::parse_backend(config_->io_backend);
+    }
 
-    // 根据值获取状态字符串并设置对应的CSS类 - 模板方法支持不同类型
-    template <typename ValueType> std::string get_state(ValueType value, bool lesser = false);
+    // 共享采样器的键：数据源加上采样后端，io-backend不同的实例各自使用独立的采样器
+    std::string sampler_key(const std::string &source) const {
+        return source + "\n" + common::SampleBatch::backend_name(sample_backend());
+    }
+
+    // 采集一次数据，默认从共享采样器取得本周期的样本
+    // 采样线程模式下在工作线程中调用，只能访问采样相关的成员，不能调用GTK
+    virtual SampleType sample();
+
+    // 共享采样器缓存的有效期
+    std::chrono::milliseconds sample_max_age() const {
+        if (bypass_sample_cache_) {
+            return std::chrono::milliseconds(0);
+        }
+        // 同一周期内触发的实例共享一次采集；缓存有效期取半个间隔，
+        // 下一个周期一定会重新采集
+        return std::chrono::milliseconds(config_->interval_ms / 2);
+    }
+
+    // 协程版本的sample()，在主线程中启动和恢复，默认直接调用sample()
+    virtual common::Task<SampleType> sample_async();
+
+    // 启动一次异步采集，上一次还在进行时返回false
+    bool start_async_update();
+    common::Task<void> run_async_update();
+
+    // 输出共享采样器的统计
+    void log_sampler_stats();
+
+    // 根据样本更新显示，总是在主线程中调用
+    virtual void render(const SampleType &sample) = 0;
+
+    // 调用sample()并发布结果
+    void publish_sample();
+
+    // 采样线程：请求一次采样，线程在第一次请求时启动
+    void request_sample();
+    void sampling_loop();
+    void notify_render();
+
+    // 渲染方法：内容与上一次相同时跳过GTK调用；frame-clock模式下暂存到下一帧
+    void set_label_text(const std::string &text);
+    void set_tooltip_enabled(bool enabled);
+
+    // frame-clock模式下请求下一帧的update阶段并返回true，调用者暂存修改；否则返回false，
+    // 调用者立即写入GTK
+    bool defer_to_frame();
+
+    // 把暂存的修改写入GTK
+    void flush_staged();
+    void apply_label();
+    void apply_css_state();
+    void apply_tooltip_enabled();
+    void disconnect_frame_clock();
+
+    // 保存最新的tooltip参数；只有鼠标悬停时才触发GTK重新查询tooltip
+    void set_tooltip_args(std::vector<common::format_arg> args);
+
+    // 渲染tooltip文本，由query-tooltip信号按需调用；返回空字符串表示不显示
+    virtual std::string render_tooltip() const;
+
+    // 获取状态对应的图标、预编译格式和名称（按键ID数组索引）
+    const std::string &get_icon(common::KeyId state) const {
+        return config_->icon_for(state);
+    }
+    const common::FormatTemplate &get_format(common::KeyId state) const {
+        return config_->format_for(state);
+    }
+    const std::string &key_name(common::KeyId state) const {
+        return config_->keys.name(state);
+    }
+
+    // 获取预编译的tooltip格式，如果format-tooltip为空则回退到默认格式
+    const common::FormatTemplate &get_tooltip_format() const;
+
+    // 根据值获取状态ID并设置对应的CSS类 - 模板方法支持不同类型，没有匹配时返回KEY_NONE
+    template <typename ValueType> common::KeyId get_state(ValueType value, bool lesser = false);
+
+    // 切换状态CSS类，只有状态变化时才修改样式上下文
+    void set_css_state(common::KeyId state);
 
     // 定时器回调
-    static gboolean timer_callback(gpointer user_data);
+    static void timer_callback(void *user_data);
+
+    // render_source_的分发回调
+    static gboolean render_source_dispatch(GSource *source, GSourceFunc callback, gpointer user_data);
 
     // 按钮点击回调
     static gboolean button_press_callback(GtkWidget *widget, GdkEventButton *event, gpointer user_data);
@@ -228,8 +810,33 @@ template <typename ConfigType> class ModuleBase {
     // 虚函数，子类可以重载来实现自定义按钮点击处理
     virtual gboolean handle_button_press(GdkEventButton *event);
 
-    // 执行动作的通用方法
-    void execute_action(const std::string &action);
+    // 触发配置中action_key对应的动作；设置了action-coalesce-ms时，
+    // 第一次触发立即执行并打开窗口，
+    // 窗口内的后续触发在窗口结束时合并执行一次
+    void trigger_action(const std::string &action_key);
+
+    // 执行动作的通用方法：通过/bin/sh -c异步启动命令，不等待它结束
+    // count为合并的触发次数，通过WAYBAR_CFFI_EVENT_COUNT环境变量传给命令
+    void execute_action(const std::string &action, uint32_t count = 1);
+
+    // 等待合并的动作，按动作键索引
+    struct PendingAction {
+        ModuleBase *module;
+        std::string key;
+        uint32_t count;
+        guint source_id;
+    };
+    std::map<std::string, PendingAction> pending_actions_;
+
+    // 取消所有等待合并的动作
+    void cancel_pending_actions();
+
+    // 合并窗口结束的回调：执行窗口内合并的触发并开始下一个窗口，
+    // 没有触发时关闭窗口
+    static gboolean action_coalesce_callback(gpointer user_data);
+
+    // 子进程退出的回调，记录非零的退出状态；user_data为命令字符串，模块可能已经销毁
+    static void action_child_watch(GPid pid, gint wait_status, gpointer user_data);
 
     // 滚轮事件回调
     static gboolean scroll_event_callback(GtkWidget *widget, GdkEventScroll *event, gpointer user_data);
@@ -239,11 +846,27 @@ template <typename ConfigType> class ModuleBase {
 
     // 窗口创建回调
     static void on_widget_realized(GtkWidget *widget, gpointer user_data);
+
+    // tooltip查询回调
+    static gboolean query_tooltip_callback(
+        GtkWidget *widget, gint x, gint y, gboolean keyboard_mode, GtkTooltip *tooltip, gpointer user_data
+    );
+
+    // 鼠标进入/离开回调
+    static gboolean crossing_callback(GtkWidget *widget, GdkEventCrossing *event, gpointer user_data);
+
+    // 映射/取消映射和可见性变化回调
+    static void map_callback(GtkWidget *widget, gpointer user_data);
+    static void unmap_callback(GtkWidget *widget, gpointer user_data);
+    static gboolean visibility_notify_callback(GtkWidget *widget, GdkEventVisibility *event, gpointer user_data);
+
+    // 帧时钟update阶段回调
+    static void frame_update_callback(GdkFrameClock *clock, gpointer user_data);
 };
 
 // ModuleBase模板实现
-template <typename ConfigType>
-ModuleBase<ConfigType>::ModuleBase(
+template <typename ConfigType, typename SampleType>
+ModuleBase<ConfigType, SampleType>::ModuleBase(
     const wbcffi_init_info *init_info, const wbcffi_config_entry *config_entries, size_t config_entries_len
 )
     : handles_button_press_(false), handles_scroll_(false) {
@@ -254,20 +877,25 @@ ModuleBase<ConfigType>::ModuleBase(
     // 初始化配置（子类应该重写此方法来创建特定类型的配置）
     config_ = std::make_unique<ConfigType>();
     config_->parse_config(config_entries, config_entries_len);
+    config_->prepare();
 
     // 初始化UI
+    frame_clock_updates_ = config_->update_mode == "frame-clock";
     init_ui(init_info);
 
     // 设置定时器实现自动刷新
+    current_interval_ms_ = config_->interval_ms;
     setup_timer();
 }
 
-template <typename ConfigType> ModuleBase<ConfigType>::~ModuleBase() {
+template <typename ConfigType, typename SampleType> ModuleBase<ConfigType, SampleType>::~ModuleBase() {
+    // wbcffi_deinit已经在派生类析构之前停止了采样线程，这里只是保险
+    stop_sampling();
+
     // 移除定时器
-    if (timer_id_ > 0) {
-        g_source_remove(timer_id_);
-        timer_id_ = 0;
-    }
+    remove_timer();
+    disconnect_frame_clock();
+    cancel_pending_actions();
 
     // 销毁GTK组件
     if (label_) {
@@ -278,7 +906,8 @@ template <typename ConfigType> ModuleBase<ConfigType>::~ModuleBase() {
     }
 }
 
-template <typename ConfigType> void ModuleBase<ConfigType>::init_ui(const wbcffi_init_info *init_info) {
+template <typename ConfigType, typename SampleType>
+void ModuleBase<ConfigType, SampleType>::init_ui(const wbcffi_init_info *init_info) {
     // 获取根容器
     GtkContainer *root = init_info->get_root_widget(init_info->obj);
 
@@ -286,15 +915,22 @@ template <typename ConfigType> void ModuleBase<ConfigType>::init_ui(const wbcffi
     event_box_ = gtk_event_box_new();
     // 设置事件盒可以接收焦点和事件
     gtk_widget_set_can_focus(event_box_, TRUE);
-    gtk_widget_add_events(event_box_, GDK_SCROLL_MASK | GDK_BUTTON_PRESS_MASK);
+    gtk_widget_add_events(
+        event_box_, GDK_SCROLL_MASK | GDK_BUTTON_PRESS_MASK | GDK_ENTER_NOTIFY_MASK | GDK_LEAVE_NOTIFY_MASK |
+                        GDK_VISIBILITY_NOTIFY_MASK
+    );
     gtk_container_add(GTK_CONTAINER(root), event_box_);
 
     // 创建标签
     label_ = gtk_label_new("");
     gtk_container_add(GTK_CONTAINER(event_box_), label_);
 
-    // 设置tooltip查询属性，确保tooltip可以显示
-    gtk_widget_set_has_tooltip(event_box_, TRUE);
+    // tooltip通过query-tooltip信号按需渲染，不再每次更新都推送文本
+    gtk_widget_set_has_tooltip(event_box_, config_->tooltip ? TRUE : FALSE);
+    tooltip_enabled_ = config_->tooltip;
+    g_signal_connect(event_box_, "query-tooltip", G_CALLBACK(query_tooltip_callback), this);
+    g_signal_connect(event_box_, "enter-notify-event", G_CALLBACK(crossing_callback), this);
+    g_signal_connect(event_box_, "leave-notify-event", G_CALLBACK(crossing_callback), this);
 
     // 设置鼠标指针
     GdkWindow *window = gtk_widget_get_window(event_box_);
@@ -316,133 +952,540 @@ template <typename ConfigType> void ModuleBase<ConfigType>::init_ui(const wbcffi
     // 添加滚轮事件处理器
     g_signal_connect(event_box_, "scroll-event", G_CALLBACK(scroll_event_callback), this);
 
+    // 跟踪可见性，状态栏隐藏或被完全遮挡时暂停采样
+    g_signal_connect(event_box_, "map", G_CALLBACK(map_callback), this);
+    g_signal_connect(event_box_, "unmap", G_CALLBACK(unmap_callback), this);
+    g_signal_connect(event_box_, "visibility-notify-event", G_CALLBACK(visibility_notify_callback), this);
+
     // 显示所有组件
     gtk_widget_show_all(event_box_);
 }
 
-template <typename ConfigType> void ModuleBase<ConfigType>::setup_timer() {
-    timer_id_ = g_timeout_add_seconds(static_cast<guint>(config_->interval), timer_callback, this);
+template <typename ConfigType, typename SampleType> void ModuleBase<ConfigType, SampleType>::setup_timer() {
+    // 由共享调度器按对齐的时刻触发，同一时刻到期的模块只需一次唤醒
+    timer_id_ = common::TickScheduler::instance().add(current_interval_ms_, timer_callback, this);
 }
 
-template <typename ConfigType> void ModuleBase<ConfigType>::refresh(int signal) {
-    (void)signal;
-    // 可以根据信号执行特定操作
-    update();
+template <typename ConfigType, typename SampleType> void ModuleBase<ConfigType, SampleType>::remove_timer() {
+    if (timer_id_ > 0) {
+        common::TickScheduler::instance().remove(timer_id_);
+        timer_id_ = 0;
+    }
 }
 
-template <typename ConfigType>
-const std::string &ModuleBase<ConfigType>::get_icon_for_state_name(const std::string &state_name) const {
-    // 从icons映射中获取图标，如果不存在则使用默认图标
-    auto it = config_->icons.find(state_name);
-    if (it != config_->icons.end()) {
-        return it->second;
+template <typename ConfigType, typename SampleType> void ModuleBase<ConfigType, SampleType>::tick() {
+    if (config_->sampling_thread) {
+        request_sample();
+    } else {
+        update();
     }
+}
 
-    // 如果找不到对应状态的图标，尝试使用默认图标
-    auto default_it = config_->icons.find("default");
-    if (default_it != config_->icons.end()) {
-        return default_it->second;
+template <typename ConfigType, typename SampleType>
+guint ModuleBase<ConfigType, SampleType>::watch_fd(int fd, uint32_t events, common::FdRegistry::Callback callback) {
+    guint id = common::FdRegistry::instance().add(fd, events, std::move(callback));
+    if (id > 0) {
+        fd_watches_.push_back(id);
     }
+    return id;
+}
 
-    // 最后的备用方案：返回空字符串
-    static const std::string empty_icon = "";
-    return empty_icon;
+template <typename ConfigType, typename SampleType> void ModuleBase<ConfigType, SampleType>::unwatch_fd(guint id) {
+    auto it = std::find(fd_watches_.begin(), fd_watches_.end(), id);
+    if (it != fd_watches_.end()) {
+        fd_watches_.erase(it);
+        common::FdRegistry::instance().remove(id);
+    }
 }
 
-template <typename ConfigType>
-const std::string &ModuleBase<ConfigType>::get_format_for_state_name(const std::string &state_name) const {
-    // 从formats映射中获取格式，如果不存在则使用默认格式
-    auto it = config_->formats.find(state_name);
-    if (it != config_->formats.end()) {
-        return it->second;
+template <typename ConfigType, typename SampleType> void ModuleBase<ConfigType, SampleType>::update_visibility() {
+    bool suspend = !mapped_ || obscured_;
+    if (suspend == suspended_) {
+        return;
     }
+    suspended_ = suspend;
 
-    // 如果找不到对应状态的格式，尝试使用默认格式
-    auto default_it = config_->formats.find("default");
-    if (default_it != config_->formats.end()) {
-        return default_it->second;
+    if (suspend) {
+        remove_timer();
+        return;
     }
 
-    // 最后的备用方案：返回空字符串
-    static const std::string empty_format = "{}";
-    return empty_format;
+    // 重新可见时从基础间隔开始，并立即补采一次，不显示隐藏期间的旧数据
+    current_interval_ms_ = config_->interval_ms;
+    unchanged_samples_ = 0;
+    setup_timer();
+    tick();
 }
 
-template <typename ConfigType> const std::string &ModuleBase<ConfigType>::get_tooltip_format() const {
-    // 如果format-tooltip不为空，使用它
-    if (!config_->format_tooltip.empty()) {
-        return config_->format_tooltip;
+template <typename ConfigType, typename SampleType>
+void ModuleBase<ConfigType, SampleType>::adapt_interval(bool changed) {
+    if (!config_->adaptive_interval || suspended_) {
+        return;
+    }
+
+    uint32_t interval_ms = current_interval_ms_;
+    if (changed) {
+        // 内容变化时立即回到基础间隔
+        unchanged_samples_ = 0;
+        interval_ms = config_->interval_ms;
+    } else if (++unchanged_samples_ >= ADAPTIVE_STEADY_SAMPLES) {
+        // 连续多次不变时间隔翻倍，仍然是基础间隔的整倍数，触发时刻保持对齐
+        unchanged_samples_ = 0;
+        interval_ms = static_cast<uint32_t>(std::min<uint64_t>(uint64_t(interval_ms) * 2, config_->max_interval_ms));
+    }
+
+    if (interval_ms != current_interval_ms_) {
+        current_interval_ms_ = interval_ms;
+        remove_timer();
+        setup_timer();
     }
+}
 
-    // 否则尝试使用默认格式
-    auto default_it = config_->formats.find("default");
-    if (default_it != config_->formats.end()) {
-        return default_it->second;
+template <typename ConfigType, typename SampleType> void ModuleBase<ConfigType, SampleType>::update() {
+    // 采样线程启动之前（包括构造函数中的初始更新）在主线程中采样
+    // 采样线程模式下不走异步采集：
+    // 进行中的协程会与之后启动的工作线程同时写入sample_slot_
+    if (!sampling_thread_.joinable()) {
+        if (!async_sampling_ || config_->sampling_thread) {
+            publish_sample();
+        } else if (start_async_update()) {
+            // 采集完成时渲染；上一次采集还在进行时先用已有的样本重新渲染
+            return;
+        }
     }
 
-    // 最后的备用方案：返回空字符串
-    static const std::string empty_format = "{}";
-    return empty_format;
+    rerender();
 }
 
-// get_state模板方法实现
-template <typename ConfigType>
-template <typename ValueType>
-std::string ModuleBase<ConfigType>::get_state(ValueType value, bool lesser) {
-    if (config_->states.empty()) {
-        return "";
+template <typename ConfigType, typename SampleType> void ModuleBase<ConfigType, SampleType>::rerender() {
+    common::CostScope cost(render_cost_);
+
+    // 先清除标记再取样本，取样本之后发布的样本会再触发一次rerender()
+    render_pending_.store(false, std::memory_order_release);
+    bool fresh = sample_slot_.consume();
+    if (fresh) {
+        has_sample_ = true;
     }
 
-    // 获取GTK样式上下文
-    GtkStyleContext *context = gtk_widget_get_style_context(event_box_);
-    if (!context) {
-        return "";
+    // 没有新样本时用上一次的样本重新渲染（例如切换了显示格式）
+    if (has_sample_) {
+        label_changed_ = false;
+        render(sample_slot_.read_buffer());
+        if (fresh) {
+            adapt_interval(label_changed_);
+        }
     }
+}
 
-    // 获取当前状态并排序
-    using ThresholdType = typename ConfigType::ThresholdType;
-    std::vector<std::pair<std::string, ThresholdType>> sorted_states;
-    for (const auto &state : config_->states) {
-        sorted_states.emplace_back(state.first, state.second);
+template <typename ConfigType, typename SampleType> void ModuleBase<ConfigType, SampleType>::sample_now() {
+    if (sampling_thread_.joinable()) {
+        request_sample();
+        return;
     }
 
-    // 根据lesser参数排序状态
-    std::sort(sorted_states.begin(), sorted_states.end(), [lesser](const auto &a, const auto &b) {
-        return lesser ? a.second < b.second : a.second > b.second;
-    });
+    bypass_sample_cache_ = true;
+    publish_sample();
+    bypass_sample_cache_ = false;
+}
+
+template <typename ConfigType, typename SampleType> SampleType ModuleBase<ConfigType, SampleType>::sample() {
+    return sampler_->sample(sample_max_age());
+}
 
-    // 找到匹配的状态并设置CSS类
-    std::string valid_state;
-    for (const auto &state : sorted_states) {
-        bool condition = lesser ? value <= state.second : value >= state.second;
-        if (condition && valid_state.empty()) {
-            gtk_style_context_add_class(context, state.first.c_str());
-            valid_state = state.first;
+template <typename ConfigType, typename SampleType>
+common::Task<SampleType> ModuleBase<ConfigType, SampleType>::sample_async() {
+    co_return sample();
+}
+
+template <typename ConfigType, typename SampleType>
+bool ModuleBase<ConfigType, SampleType>::start_async_update() {
+    // 上一次采集还在等待时合并请求
+    if (async_update_.valid() && !async_update_.done()) {
+        return false;
+    }
+
+    async_update_ = run_async_update();
+    async_update_.start();
+    return true;
+}
+
+template <typename ConfigType, typename SampleType>
+common::Task<void> ModuleBase<ConfigType, SampleType>::run_async_update() {
+    try {
+        // 挂起期间主线程在做其他工作，只记录耗时
+        common::CostScope cost(sample_cost_, false);
+        sample_slot_.write_buffer() = co_await sample_async();
+        sample_slot_.publish();
+    } catch (const std::exception &e) {
+        common::log_error("Error sampling module data: {}", e.what());
+    }
+    rerender();
+}
+
+template <typename ConfigType, typename SampleType> void ModuleBase<ConfigType, SampleType>::log_sampler_stats() {
+    if (sampler_) {
+        sampler_->log_stats(sampler_.use_count());
+    }
+}
+
+template <typename ConfigType, typename SampleType> void ModuleBase<ConfigType, SampleType>::publish_sample() {
+    common::CostScope cost(sample_cost_);
+    try {
+        sample_slot_.write_buffer() = sample();
+        sample_slot_.publish();
+    } catch (const std::exception &e) {
+        common::log_error("Error sampling module data: {}", e.what());
+    }
+}
+
+template <typename ConfigType, typename SampleType> void ModuleBase<ConfigType, SampleType>::request_sample() {
+    if (!sampling_thread_.joinable()) {
+        // 没有queue_update回调时，用一个就绪时间由工作线程设置的GSource唤醒主线程
+        if (!queue_update_ && !render_source_) {
+            static GSourceFuncs funcs = {nullptr, nullptr, render_source_dispatch, nullptr, nullptr, nullptr};
+            render_source_ = g_source_new(&funcs, sizeof(RenderSource));
+            reinterpret_cast<RenderSource *>(render_source_)->module = this;
+            g_source_set_name(render_source_, "waybar-cffi-render");
+            g_source_attach(render_source_, nullptr);
+        }
+        sampling_thread_ = std::thread([this]() { sampling_loop(); });
+    }
+
+    // 工作线程忙于上一次采样时，多个请求合并为一次
+    sample_requests_.fetch_add(1, std::memory_order_release);
+    sample_requests_.notify_one();
+}
+
+template <typename ConfigType, typename SampleType> void ModuleBase<ConfigType, SampleType>::sampling_loop() {
+    uint32_t handled = 0;
+    while (true) {
+        uint32_t requested = sample_requests_.load(std::memory_order_acquire);
+        if (sampling_stop_.load(std::memory_order_acquire)) {
+            break;
+        }
+        if (requested == handled) {
+            sample_requests_.wait(requested, std::memory_order_acquire);
+            continue;
+        }
+        handled = requested;
+
+        publish_sample();
+        if (stats_requested_.exchange(false, std::memory_order_acq_rel)) {
+            log_sampler_stats();
+        }
+        notify_render();
+    }
+}
+
+template <typename ConfigType, typename SampleType> void ModuleBase<ConfigType, SampleType>::notify_render() {
+    // 主线程还没有处理上一次通知时不再重复通知，它会取到最新的样本
+    if (render_pending_.exchange(true, std::memory_order_acq_rel)) {
+        return;
+    }
+
+    // queue_update和g_source_set_ready_time都可以在其他线程中调用
+    if (queue_update_) {
+        queue_update_(obj_);
+    } else if (render_source_) {
+        g_source_set_ready_time(render_source_, 0);
+    }
+}
+
+template <typename ConfigType, typename SampleType> void ModuleBase<ConfigType, SampleType>::stop_sampling() {
+    // 事件回调和异步采集都会访问派生类的成员
+    for (guint id : fd_watches_) {
+        common::FdRegistry::instance().remove(id);
+    }
+    fd_watches_.clear();
+    async_update_.reset();
+
+    if (sampling_thread_.joinable()) {
+        sampling_stop_.store(true, std::memory_order_release);
+        sample_requests_.fetch_add(1, std::memory_order_release);
+        sample_requests_.notify_one();
+        sampling_thread_.join();
+    }
+
+    if (render_source_) {
+        g_source_destroy(render_source_);
+        g_source_unref(render_source_);
+        render_source_ = nullptr;
+    }
+}
+
+template <typename ConfigType, typename SampleType>
+gboolean ModuleBase<ConfigType, SampleType>::render_source_dispatch(
+    GSource *source, GSourceFunc callback, gpointer user_data
+) {
+    (void)callback;
+    (void)user_data;
+    g_source_set_ready_time(source, -1);
+    reinterpret_cast<RenderSource *>(source)->module->rerender();
+    return G_SOURCE_CONTINUE;
+}
+
+template <typename ConfigType, typename SampleType>
+void ModuleBase<ConfigType, SampleType>::set_label_text(const std::string &text) {
+    if (label_rendered_ && text == last_label_) {
+        render_stats_.skipped++;
+        return;
+    }
+
+    last_label_ = text;
+    label_rendered_ = true;
+    label_changed_ = true;
+    if (defer_to_frame()) {
+        label_staged_ = true;
+    } else {
+        apply_label();
+    }
+}
+
+template <typename ConfigType, typename SampleType> void ModuleBase<ConfigType, SampleType>::apply_label() {
+    gtk_label_set_text(GTK_LABEL(label_), last_label_.c_str());
+    render_stats_.applied++;
+}
+
+
+template <typename ConfigType, typename SampleType>
+void ModuleBase<ConfigType, SampleType>::set_tooltip_enabled(bool enabled) {
+    if (tooltip_enabled_ == enabled) {
+        render_stats_.skipped++;
+        return;
+    }
+
+    tooltip_enabled_ = enabled;
+    if (defer_to_frame()) {
+        tooltip_enabled_staged_ = true;
+    } else {
+        apply_tooltip_enabled();
+    }
+}
+
+template <typename ConfigType, typename SampleType> void ModuleBase<ConfigType, SampleType>::apply_tooltip_enabled() {
+    gtk_widget_set_has_tooltip(event_box_, tooltip_enabled_ ? TRUE : FALSE);
+    render_stats_.applied++;
+}
+
+template <typename ConfigType, typename SampleType> bool ModuleBase<ConfigType, SampleType>::defer_to_frame() {
+    if (!frame_clock_updates_) {
+        return false;
+    }
+
+    // 组件实现之前没有帧时钟，此时直接写入，并先写入之前暂存的修改
+    GdkFrameClock *clock = gtk_widget_get_frame_clock(event_box_);
+    if (!clock) {
+        flush_staged();
+        return false;
+    }
+
+    // 组件被移到其他顶层窗口后帧时钟会变化
+    if (clock != frame_clock_) {
+        disconnect_frame_clock();
+        frame_clock_ = static_cast<GdkFrameClock *>(g_object_ref(clock));
+        frame_update_handler_ = g_signal_connect(clock, "update", G_CALLBACK(frame_update_callback), this);
+    }
+
+    if (!frame_pending_) {
+        frame_pending_ = true;
+        gdk_frame_clock_request_phase(clock, GDK_FRAME_CLOCK_PHASE_UPDATE);
+    }
+    return true;
+}
+
+template <typename ConfigType, typename SampleType> void ModuleBase<ConfigType, SampleType>::flush_staged() {
+    frame_pending_ = false;
+    if (label_staged_) {
+        label_staged_ = false;
+        apply_label();
+    }
+    if (css_staged_) {
+        css_staged_ = false;
+        apply_css_state();
+    }
+    if (tooltip_enabled_staged_) {
+        tooltip_enabled_staged_ = false;
+        apply_tooltip_enabled();
+    }
+}
+
+template <typename ConfigType, typename SampleType>
+void ModuleBase<ConfigType, SampleType>::disconnect_frame_clock() {
+    if (frame_clock_) {
+        g_signal_handler_disconnect(frame_clock_, frame_update_handler_);
+        g_object_unref(frame_clock_);
+        frame_clock_ = nullptr;
+        frame_update_handler_ = 0;
+    }
+}
+
+template <typename ConfigType, typename SampleType>
+void ModuleBase<ConfigType, SampleType>::set_tooltip_args(std::vector<common::format_arg> args) {
+    tooltip_args_ = std::move(args);
+
+    // tooltip可能正在显示，让GTK重新查询以刷新内容
+    if (hovered_ && tooltip_enabled_) {
+        gtk_widget_trigger_tooltip_query(event_box_);
+    }
+}
+
+template <typename ConfigType, typename SampleType>
+std::string ModuleBase<ConfigType, SampleType>::render_tooltip() const {
+    const common::FormatTemplate &tooltip_format = get_tooltip_format();
+    if (!config_->tooltip_uses_debug_args) {
+        return common::safe_execute<std::string>(
+            [&]() { return tooltip_format.render(tooltip_args_); }, tooltip_format.source(), "Error formatting tooltip"
+        );
+    }
+
+    // 调试占位符的下标紧跟在format_args之后
+    std::vector<common::format_arg> args = tooltip_args_;
+    args.resize(config_->format_args.size());
+    std::vector<common::format_arg> debug_values = debug_format_values();
+    args.insert(args.end(), std::make_move_iterator(debug_values.begin()), std::make_move_iterator(debug_values.end()));
+    return common::safe_execute<std::string>(
+        [&]() { return tooltip_format.render(args); }, tooltip_format.source(), "Error formatting tooltip"
+    );
+}
+
+template <typename ConfigType, typename SampleType>
+std::vector<common::format_arg> ModuleBase<ConfigType, SampleType>::debug_format_values() const {
+    auto us = [](uint64_t value) { return static_cast<int>(std::min<uint64_t>(value, INT_MAX)); };
+    int sources = sampler_ ? us(sampler_->last_reads()) : 0;
+    return {
+        us(sample_cost_.latency_us.percentile(0.5)),
+        us(sample_cost_.latency_us.percentile(0.99)),
+        us(sample_cost_.latency_us.max()),
+        sample_cost_.average_cpu_us(),
+        us(sample_cost_.latency_us.count()),
+        sources,
+        us(render_cost_.latency_us.percentile(0.99)),
+        us(render_cost_.latency_us.max()),
+        us(action_cost_.latency_us.percentile(0.99)),
+        us(action_cost_.latency_us.max()),
+        us(refresh_cost_.latency_us.percentile(0.99)),
+        us(refresh_cost_.latency_us.max()),
+    };
+}
+
+template <typename ConfigType, typename SampleType> void ModuleBase<ConfigType, SampleType>::log_cost_stats() const {
+    const common::LatencyHistogram &update = sample_cost_.latency_us;
+    const common::LatencyHistogram &render = render_cost_.latency_us;
+    common::log_info(
+        "Module cost: updates={} p50={}us p99={}us max={}us cpu avg={:.1f}us; "
+        "renders={} p99={}us max={}us cpu avg={:.1f}us; actions={} p99={}us max={}us; refreshes={} p99={}us max={}us",
+        update.count(), update.percentile(0.5), update.percentile(0.99), update.max(), sample_cost_.average_cpu_us(),
+        render.count(), render.percentile(0.99), render.max(), render_cost_.average_cpu_us(),
+        action_cost_.latency_us.count(), action_cost_.latency_us.percentile(0.99), action_cost_.latency_us.max(),
+        refresh_cost_.latency_us.count(), refresh_cost_.latency_us.percentile(0.99), refresh_cost_.latency_us.max()
+    );
+}
+
+template <typename ConfigType, typename SampleType> void ModuleBase<ConfigType, SampleType>::refresh(int signal) {
+    common::CostScope cost(refresh_cost_);
+
+    // 收到stats-signal时输出采样统计和自身开销
+    bool dump_stats = config_->stats_signal > 0 && signal == SIGRTMIN + config_->stats_signal;
+    if (dump_stats) {
+        log_cost_stats();
+        const common::TickScheduler &scheduler = common::TickScheduler::instance();
+        common::log_info(
+            "Tick scheduler: interval={}ms current={}ms suspended={} tasks={} wakeups={} dispatches={}",
+            config_->interval_ms, current_interval_ms_, suspended_, scheduler.task_count(), scheduler.wakeups(),
+            scheduler.dispatches()
+        );
+        if (!fd_watches_.empty()) {
+            const common::FdRegistry &registry = common::FdRegistry::instance();
+            common::log_info(
+                "Fd registry: module watches={} watches={} wakeups={} dispatches={}", fd_watches_.size(),
+                registry.watch_count(), registry.wakeups(), registry.dispatches()
+            );
+        }
+
+        if (sampling_thread_.joinable()) {
+            // 采样统计属于工作线程，由它在下一次采样后输出
+            stats_requested_.store(true, std::memory_order_release);
+            request_sample();
         } else {
-            gtk_style_context_remove_class(context, state.first.c_str());
+            log_sampler_stats();
         }
     }
 
+    rerender();
+}
+
+template <typename ConfigType, typename SampleType>
+const common::FormatTemplate &ModuleBase<ConfigType, SampleType>::get_tooltip_format() const {
+    return config_->compiled_tooltip;
+}
+
+// get_state模板方法实现
+template <typename ConfigType, typename SampleType>
+template <typename ValueType>
+common::KeyId ModuleBase<ConfigType, SampleType>::get_state(ValueType value, bool lesser) {
+    // 使用解析配置时预排序的阈值表
+    common::KeyId valid_state = config_->match_state(static_cast<double>(value), lesser);
+    set_css_state(valid_state);
     return valid_state;
 }
 
+template <typename ConfigType, typename SampleType>
+void ModuleBase<ConfigType, SampleType>::set_css_state(common::KeyId state) {
+    if (state == css_state_) {
+        render_stats_.skipped++;
+        return;
+    }
+
+    css_state_ = state;
+    if (defer_to_frame()) {
+        css_staged_ = true;
+    } else {
+        apply_css_state();
+    }
+}
+
+template <typename ConfigType, typename SampleType> void ModuleBase<ConfigType, SampleType>::apply_css_state() {
+    // 样式类的变化会使CSS失效并触发重新计算样式，因此只在状态切换时操作
+    // 暂存期间状态可能又切换回来
+    if (css_state_ == applied_css_state_) {
+        return;
+    }
+
+    GtkStyleContext *context = gtk_widget_get_style_context(event_box_);
+    if (!context) {
+        return;
+    }
+
+    if (applied_css_state_ != common::KEY_NONE) {
+        gtk_style_context_remove_class(context, key_name(applied_css_state_).c_str());
+    }
+    if (css_state_ != common::KEY_NONE) {
+        gtk_style_context_add_class(context, key_name(css_state_).c_str());
+    }
+    applied_css_state_ = css_state_;
+    render_stats_.applied++;
+}
+
 // 定时器回调
-template <typename ConfigType> gboolean ModuleBase<ConfigType>::timer_callback(gpointer user_data) {
-    ModuleBase<ConfigType> *module = static_cast<ModuleBase<ConfigType> *>(user_data);
+template <typename ConfigType, typename SampleType>
+void ModuleBase<ConfigType, SampleType>::timer_callback(void *user_data) {
+    ModuleBase<ConfigType, SampleType> *module = static_cast<ModuleBase<ConfigType, SampleType> *>(user_data);
     if (module) {
-        module->update();
+        module->tick();
     }
-    return G_SOURCE_CONTINUE;
 }
 
 // 按钮点击回调
-template <typename ConfigType>
-gboolean ModuleBase<ConfigType>::button_press_callback(GtkWidget *widget, GdkEventButton *event, gpointer user_data) {
+template <typename ConfigType, typename SampleType>
+gboolean ModuleBase<ConfigType, SampleType>::button_press_callback(
+    GtkWidget *widget, GdkEventButton *event, gpointer user_data
+) {
     (void)widget;
-    ModuleBase<ConfigType> *module = static_cast<ModuleBase<ConfigType> *>(user_data);
+    ModuleBase<ConfigType, SampleType> *module = static_cast<ModuleBase<ConfigType, SampleType> *>(user_data);
     if (module) {
         common::log_info("Button press event received in module");
         // 调用虚函数，允许子类重载行为
+        common::CostScope cost(module->action_cost_);
         module->handle_button_press(event);
         // 总是返回TRUE，阻止事件继续传递给Waybar
         return TRUE;
@@ -452,7 +1495,8 @@ gboolean ModuleBase<ConfigType>::button_press_callback(GtkWidget *widget, GdkEve
 }
 
 // 默认的虚函数实现
-template <typename ConfigType> gboolean ModuleBase<ConfigType>::handle_button_press(GdkEventButton *event) {
+template <typename ConfigType, typename SampleType>
+gboolean ModuleBase<ConfigType, SampleType>::handle_button_press(GdkEventButton *event) {
     // 根据按钮类型确定动作键
     std::string action_key;
     switch (event->button) {
@@ -469,36 +1513,126 @@ template <typename ConfigType> gboolean ModuleBase<ConfigType>::handle_button_pr
         return TRUE; // 不处理其他按钮
     }
 
+    trigger_action(action_key);
+
+    return TRUE;
+}
+
+template <typename ConfigType, typename SampleType>
+void ModuleBase<ConfigType, SampleType>::trigger_action(const std::string &action_key) {
     // 查找配置的动作
     auto it = config_->actions.find(action_key);
-    if (it != config_->actions.end()) {
+    if (it == config_->actions.end()) {
+        return;
+    }
+
+    if (config_->action_coalesce_ms <= 0) {
         execute_action(it->second);
+        return;
     }
 
-    return TRUE;
+    // 窗口内的后续触发只累加次数，在窗口结束时合并执行一次，
+    // 例如一次平滑滚动产生的大量滚轮事件最多每个窗口启动一次命令
+    auto pending = pending_actions_.find(action_key);
+    if (pending != pending_actions_.end()) {
+        pending->second.count++;
+        return;
+    }
+
+    // 窗口外的第一次触发立即执行，单次点击不等待窗口
+    execute_action(it->second);
+    PendingAction &action = pending_actions_[action_key];
+    action = PendingAction{this, action_key, 0, 0};
+    action.source_id = g_timeout_add_full(
+        G_PRIORITY_DEFAULT, guint(config_->action_coalesce_ms), action_coalesce_callback, &action, nullptr
+    );
+}
+
+template <typename ConfigType, typename SampleType>
+gboolean ModuleBase<ConfigType, SampleType>::action_coalesce_callback(gpointer user_data) {
+    PendingAction *action = static_cast<PendingAction *>(user_data);
+    ModuleBase *module = action->module;
+    if (action->count == 0) {
+        // 窗口内没有后续触发，关闭窗口
+        module->pending_actions_.erase(action->key);
+        return G_SOURCE_REMOVE;
+    }
+
+    // 执行窗口内合并的触发，并开始下一个窗口，持续的触发最多每个窗口执行一次
+    uint32_t count = action->count;
+    action->count = 0;
+
+    // 等待期间配置不会变化，动作一定存在
+    auto it = module->config_->actions.find(action->key);
+    if (it != module->config_->actions.end()) {
+        module->execute_action(it->second, count);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+template <typename ConfigType, typename SampleType>
+void ModuleBase<ConfigType, SampleType>::cancel_pending_actions() {
+    for (auto &[key, action] : pending_actions_) {
+        g_source_remove(action.source_id);
+    }
+    pending_actions_.clear();
 }
 
 // 执行动作的通用方法
-template <typename ConfigType> void ModuleBase<ConfigType>::execute_action(const std::string &action) {
+template <typename ConfigType, typename SampleType>
+void ModuleBase<ConfigType, SampleType>::execute_action(const std::string &action, uint32_t count) {
     if (action.empty()) {
         return;
     }
 
-    // 使用system执行命令
-    int result = std::system(action.c_str());
-    if (result != 0) {
-        common::log_error("Failed to execute action '{}', exit code: {}", action, result);
+    // 异步启动，缓慢的命令（例如弹出菜单）不会阻塞状态栏；子进程由child watch回收
+    gchar *argv[] = {const_cast<gchar *>("/bin/sh"), const_cast<gchar *>("-c"), const_cast<gchar *>(action.c_str()),
+                     nullptr};
+    gchar **envp = g_get_environ();
+    envp = g_environ_setenv(envp, "WAYBAR_CFFI_EVENT_COUNT", std::to_string(count).c_str(), TRUE);
+
+    GPid pid = 0;
+    GError *error = nullptr;
+    gboolean spawned =
+        g_spawn_async(nullptr, argv, envp, G_SPAWN_DO_NOT_REAP_CHILD, nullptr, nullptr, &pid, &error);
+    g_strfreev(envp);
+
+    if (!spawned) {
+        common::log_error("Failed to execute action '{}': {}", action, error ? error->message : "unknown error");
+        g_clear_error(&error);
+        return;
     }
+
+    g_child_watch_add(pid, action_child_watch, g_strdup(action.c_str()));
+}
+
+template <typename ConfigType, typename SampleType>
+void ModuleBase<ConfigType, SampleType>::action_child_watch(GPid pid, gint wait_status, gpointer user_data) {
+    gchar *action = static_cast<gchar *>(user_data);
+    GError *error = nullptr;
+#if GLIB_CHECK_VERSION(2, 70, 0)
+    gboolean succeeded = g_spawn_check_wait_status(wait_status, &error);
+#else
+    gboolean succeeded = g_spawn_check_exit_status(wait_status, &error);
+#endif
+    if (!succeeded) {
+        common::log_error("Action '{}' failed: {}", action, error ? error->message : "unknown error");
+        g_clear_error(&error);
+    }
+    g_spawn_close_pid(pid);
+    g_free(action);
 }
 
 // 滚轮事件回调
-template <typename ConfigType>
-gboolean ModuleBase<ConfigType>::scroll_event_callback(GtkWidget *widget, GdkEventScroll *event, gpointer user_data) {
+template <typename ConfigType, typename SampleType>
+gboolean ModuleBase<ConfigType, SampleType>::scroll_event_callback(
+    GtkWidget *widget, GdkEventScroll *event, gpointer user_data
+) {
     (void)widget;
-    ModuleBase<ConfigType> *module = static_cast<ModuleBase<ConfigType> *>(user_data);
+    ModuleBase<ConfigType, SampleType> *module = static_cast<ModuleBase<ConfigType, SampleType> *>(user_data);
     if (module) {
         // 记录滚轮方向
-        std::string direction;
+        const char *direction = nullptr;
         switch (event->direction) {
         case GDK_SCROLL_UP:
             direction = "UP";
@@ -522,6 +1656,7 @@ gboolean ModuleBase<ConfigType>::scroll_event_callback(GtkWidget *widget, GdkEve
         common::log_info("Scroll event received in module, direction: {}", direction);
 
         // 调用虚函数，允许子类重载行为
+        common::CostScope cost(module->action_cost_);
         module->handle_scroll(event);
         // 总是返回TRUE，阻止事件继续传递给Waybar
         return TRUE;
@@ -531,7 +1666,8 @@ gboolean ModuleBase<ConfigType>::scroll_event_callback(GtkWidget *widget, GdkEve
 }
 
 // 默认的滚轮事件虚函数实现
-template <typename ConfigType> gboolean ModuleBase<ConfigType>::handle_scroll(GdkEventScroll *event) {
+template <typename ConfigType, typename SampleType>
+gboolean ModuleBase<ConfigType, SampleType>::handle_scroll(GdkEventScroll *event) {
     // 根据滚动方向确定动作键
     std::string action_key;
     switch (event->direction) {
@@ -551,19 +1687,16 @@ template <typename ConfigType> gboolean ModuleBase<ConfigType>::handle_scroll(Gd
         return TRUE; // 不处理其他滚动方向
     }
 
-    // 查找配置的动作
-    auto it = config_->actions.find(action_key);
-    if (it != config_->actions.end()) {
-        execute_action(it->second);
-    }
+    trigger_action(action_key);
 
     return TRUE;
 }
 
 // 窗口创建回调
-template <typename ConfigType> void ModuleBase<ConfigType>::on_widget_realized(GtkWidget *widget, gpointer user_data) {
+template <typename ConfigType, typename SampleType>
+void ModuleBase<ConfigType, SampleType>::on_widget_realized(GtkWidget *widget, gpointer user_data) {
     (void)widget;
-    ModuleBase<ConfigType> *module = static_cast<ModuleBase<ConfigType> *>(user_data);
+    ModuleBase<ConfigType, SampleType> *module = static_cast<ModuleBase<ConfigType, SampleType> *>(user_data);
     if (module && module->event_box_) {
         GdkWindow *window = gtk_widget_get_window(module->event_box_);
         if (window) {
@@ -577,6 +1710,89 @@ template <typename ConfigType> void ModuleBase<ConfigType>::on_widget_realized(G
     }
 }
 
+// tooltip查询回调
+template <typename ConfigType, typename SampleType>
+gboolean ModuleBase<ConfigType, SampleType>::query_tooltip_callback(
+    GtkWidget *widget, gint x, gint y, gboolean keyboard_mode, GtkTooltip *tooltip, gpointer user_data
+) {
+    (void)widget;
+    (void)x;
+    (void)y;
+    (void)keyboard_mode;
+    ModuleBase<ConfigType, SampleType> *module = static_cast<ModuleBase<ConfigType, SampleType> *>(user_data);
+    if (!module || !module->config_->tooltip) {
+        return FALSE;
+    }
+
+    std::string text = module->render_tooltip();
+    if (text.empty()) {
+        return FALSE;
+    }
+
+    gtk_tooltip_set_text(tooltip, text.c_str());
+    return TRUE;
+}
+
+// 鼠标进入/离开回调
+template <typename ConfigType, typename SampleType>
+gboolean ModuleBase<ConfigType, SampleType>::crossing_callback(
+    GtkWidget *widget, GdkEventCrossing *event, gpointer user_data
+) {
+    (void)widget;
+    ModuleBase<ConfigType, SampleType> *module = static_cast<ModuleBase<ConfigType, SampleType> *>(user_data);
+    if (module) {
+        module->hovered_ = event->type == GDK_ENTER_NOTIFY;
+    }
+    // 返回FALSE让事件继续传递
+    return FALSE;
+}
+
+// 帧时钟update阶段回调，在布局和绘制之前写入本帧暂存的修改
+template <typename ConfigType, typename SampleType>
+void ModuleBase<ConfigType, SampleType>::frame_update_callback(GdkFrameClock *clock, gpointer user_data) {
+    (void)clock;
+    ModuleBase<ConfigType, SampleType> *module = static_cast<ModuleBase<ConfigType, SampleType> *>(user_data);
+    if (module && module->frame_pending_) {
+        module->flush_staged();
+    }
+}
+
+// 映射回调
+template <typename ConfigType, typename SampleType>
+void ModuleBase<ConfigType, SampleType>::map_callback(GtkWidget *widget, gpointer user_data) {
+    (void)widget;
+    ModuleBase<ConfigType, SampleType> *module = static_cast<ModuleBase<ConfigType, SampleType> *>(user_data);
+    if (module) {
+        module->mapped_ = true;
+        module->update_visibility();
+    }
+}
+
+// 取消映射回调（例如状态栏被隐藏）
+template <typename ConfigType, typename SampleType>
+void ModuleBase<ConfigType, SampleType>::unmap_callback(GtkWidget *widget, gpointer user_data) {
+    (void)widget;
+    ModuleBase<ConfigType, SampleType> *module = static_cast<ModuleBase<ConfigType, SampleType> *>(user_data);
+    if (module) {
+        module->mapped_ = false;
+        module->update_visibility();
+    }
+}
+
+// 可见性变化回调，只有支持遮挡通知的窗口系统才会触发
+template <typename ConfigType, typename SampleType>
+gboolean ModuleBase<ConfigType, SampleType>::visibility_notify_callback(
+    GtkWidget *widget, GdkEventVisibility *event, gpointer user_data
+) {
+    (void)widget;
+    ModuleBase<ConfigType, SampleType> *module = static_cast<ModuleBase<ConfigType, SampleType> *>(user_data);
+    if (module) {
+        module->obscured_ = event->state == GDK_VISIBILITY_FULLY_OBSCURED;
+        module->update_visibility();
+    }
+    return FALSE;
+}
+
 } // namespace waybar::cffi::base
 
-#endif // WAYBAR_CFFI_MODULE_BASE_HPP
\ No newline at end of file
+#endif // WAYBAR_CFFI_MODULE_BASE_HPP
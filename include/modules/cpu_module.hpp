@@ -18,11 +18,39 @@ struct CpuConfig : public base::ModuleConfigBase<int> {
         icons["default"] = "󰾆";
         formats["default"] = "{icon}\u2004{usage}%";
         format_tooltip = "CPU Usage: {usage}%\nState: {state}";
+        format_args = {"icon", "usage", "state"};
     }
 };
 
+// 一次采样的结果
+struct CpuSample {
+    float usage = 0.0f; // CPU使用率（百分比）
+};
+
+// /proc/stat采样器，所有CPU模块实例共享
+class CpuSampler : public base::SharedSampler<CpuSample> {
+  public:
+    explicit CpuSampler(common::SampleBatch::Backend backend);
+
+  protected:
+    CpuSample collect() override;
+
+  private:
+    // CPU信息获取
+    struct CpuTimes {
+        uint64_t idle;
+        uint64_t total;
+    } prev_times = {0, 0};
+
+    // /proc/stat在采样批次中的下标
+    size_t stat_index_ = 0;
+
+    CpuTimes get_cpu_times();
+    float calculate_cpu_usage(const CpuTimes &prev, const CpuTimes &curr) const;
+};
+
 // CPU模块类
-class CpuModule : public base::ModuleBase<CpuConfig> {
+class CpuModule : public base::ModuleBase<CpuConfig, CpuSample> {
   public:
     CpuModule(const wbcffi_init_info *init_info, const wbcffi_config_entry *config_entries, size_t config_entries_len);
     ~CpuModule() = default;
@@ -33,17 +61,8 @@ class CpuModule : public base::ModuleBase<CpuConfig> {
     CpuModule(CpuModule &&) = delete;
     CpuModule &operator=(CpuModule &&) = delete;
 
-    // 更新函数
-    void update();
-
-  private:
-    // CPU信息获取
-    struct CpuTimes {
-        uint64_t idle;
-        uint64_t total;
-    } prev_times = {0, 0};
-    CpuTimes get_cpu_times() const;
-    float calculate_cpu_usage(const CpuTimes &prev, const CpuTimes &curr) const;
+  protected:
+    void render(const CpuSample &sample) override;
 };
 
 } // namespace waybar::cffi::cpu
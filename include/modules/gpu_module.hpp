@@ -16,14 +16,15 @@ struct GpuConfig : public base::ModuleConfigBase<int> {
 
     std::string gpu_usage_path = "/sys/class/drm/card1/device/gpu_busy_percent";
     std::string vram_used_path = "/sys/class/drm/card1/device/mem_info_vram_used";
-    std::string format_tooltip = "GPU: {gpu_usage}%\nVRAM: {vram_used}G";
 
     GpuConfig() {
         icons["default"] = "󰍹";
         formats["default"] = "{icon}\u2004{gpu_usage:>2}%";
         formats["alt"] = "{icon}\u2004{vram_used}GB";
+        format_tooltip = "GPU: {gpu_usage}%\nVRAM: {vram_used}G";
         states["warning"] = 20;
         states["critical"] = 50;
+        format_args = {"icon", "gpu_usage", "vram_used", "state"};
     }
 
     // 重写parse_config方法以处理特定配置
@@ -34,12 +35,37 @@ struct GpuConfig : public base::ModuleConfigBase<int> {
         // 解析特定配置
         gpu_usage_path = common::get_config_value<std::string>(config_map, "gpu-usage-path", gpu_usage_path);
         vram_used_path = common::get_config_value<std::string>(config_map, "vram-used-path", vram_used_path);
-        format_tooltip = common::get_config_value<std::string>(config_map, "format-tooltip", format_tooltip);
     }
 };
 
+// 一次采样的结果
+struct GpuSample {
+    int gpu_usage = 0;      // GPU使用率（百分比）
+    double vram_used = 0.0; // VRAM使用量（GB）
+};
+
+// GPU采样器，读取同一组sysfs文件的实例共享
+class GpuSampler : public base::SharedSampler<GpuSample> {
+  public:
+    GpuSampler(const GpuConfig &config, common::SampleBatch::Backend backend);
+
+  protected:
+    GpuSample collect() override;
+
+  private:
+    // 各数据源在采样批次中的下标及其健康状态
+    size_t gpu_usage_index_ = 0;
+    size_t vram_used_index_ = 0;
+    common::SourceHealth gpu_usage_health_{"GPU usage"};
+    common::SourceHealth vram_used_health_{"VRAM usage"};
+
+    // GPU信息获取
+    int get_gpu_usage(common::SourceHealth::clock::time_point now);
+    double get_vram_used(common::SourceHealth::clock::time_point now); // 返回GB单位
+};
+
 // GPU模块类
-class GpuModule : public base::ModuleBase<GpuConfig> {
+class GpuModule : public base::ModuleBase<GpuConfig, GpuSample> {
   public:
     GpuModule(const wbcffi_init_info *init_info, const wbcffi_config_entry *config_entries, size_t config_entries_len);
     ~GpuModule() = default;
@@ -50,19 +76,15 @@ class GpuModule : public base::ModuleBase<GpuConfig> {
     GpuModule(GpuModule &&) = delete;
     GpuModule &operator=(GpuModule &&) = delete;
 
-    // 更新函数
-    void update() override;
-
     // 处理点击事件，用于切换显示模式
     gboolean handle_button_press(GdkEventButton *event) override;
 
-  private:
-    // 当前使用的格式键，"default"或"alt"
-    std::string current_format_key_ = "default";
+  protected:
+    void render(const GpuSample &sample) override;
 
-    // GPU信息获取
-    int get_gpu_usage() const;
-    double get_vram_used() const; // 返回GB单位
+  private:
+    // 当前使用的格式键，KEY_DEFAULT或KEY_ALT
+    common::KeyId current_format_key_ = common::KEY_DEFAULT;
 };
 
 } // namespace waybar::cffi::gpu
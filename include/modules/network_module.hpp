@@ -27,6 +27,13 @@ struct NetworkInterface {
     uint64_t tx_bytes; // 发送字节数
 };
 
+// 网络采样器的可选采集项
+enum NetworkCollector : uint32_t {
+    COLLECT_SSID = 1u << 0,    // 无线接口的SSID（每个无线接口一次ioctl）
+    COLLECT_QUALITY = 1u << 1, // 无线信号统计（每个无线接口一次ioctl）
+    COLLECT_IPV6 = 1u << 2,    // IPv6地址
+};
+
 // 配置结构体 - 使用int类型的阈值
 struct NetworkConfig : public base::ModuleConfigBase<int> {
     using ThresholdType = int;
@@ -35,6 +42,7 @@ struct NetworkConfig : public base::ModuleConfigBase<int> {
     std::string interface;             // 指定监控的网络接口，空字符串表示自动选择
     bool accumulate_bandwidth = false; // 是否累积带宽统计
     int max_bandwidth = 1000;          // 最大带宽（Mbps），用于计算百分比
+    bool wireless_states = false;      // 用户在states中配置了wireless-N阈值（默认阈值不算）
 
     NetworkConfig() {
         icons["default"] = "󰈀";
@@ -67,6 +75,16 @@ struct NetworkConfig : public base::ModuleConfigBase<int> {
                          "RX Rate: {bandwidthRx}\nTX Rate: {bandwidthTx}\n"
                          "Net Speed: {netspeed}";
 
+        format_args = {"icon",           "ifname",         "ipaddr",      "ipv6",        "essid",
+                       "quality_level",  "quality_link",   "quality_noise",
+                       "bandwidthRxTot", "bandwidthTxTot", "bandwidthRx", "bandwidthTx", "netcidr",
+                       "netspeed"};
+
+        // 只有被引用的占位符对应的数据才会采集
+        collector_args = {{"essid", COLLECT_SSID},           {"quality_level", COLLECT_QUALITY},
+                          {"quality_link", COLLECT_QUALITY}, {"quality_noise", COLLECT_QUALITY},
+                          {"icon", COLLECT_QUALITY},         {"ipv6", COLLECT_IPV6}};
+
         // 默认鼠标事件动作
         actions["on-middle-click"] = "LANG=en_US.UTF-8 iwmenu -l rofi";
     }
@@ -75,8 +93,82 @@ struct NetworkConfig : public base::ModuleConfigBase<int> {
     void parse_config(const wbcffi_config_entry *entries, size_t count) override;
 };
 
+// 一次采样的结果
+struct NetworkSample {
+    bool connected = false; // 是否找到了可用接口
+    NetworkInterface iface; // 选定的接口
+    uint64_t rx_rate = 0;   // 接收速率（字节/秒）
+    uint64_t tx_rate = 0;   // 发送速率（字节/秒）
+};
+
+// 网络接口采样器，监控同一接口配置的实例共享
+class NetworkSampler : public base::SharedSampler<NetworkSample> {
+  public:
+    // interface为指定监控的网络接口，空字符串表示自动选择
+    NetworkSampler(std::string interface, common::SampleBatch::Backend backend);
+    ~NetworkSampler() override;
+
+    // 订阅链路和地址变化的netlink套接字，创建失败时为-1
+    int event_fd() const {
+        return netlink_fd_;
+    }
+
+    // 读走所有待处理的netlink消息，有消息时使缓存的样本失效
+    void drain_events();
+
+    // 协程版本的sample()：接口扫描和无线信息查询在后台线程中进行，期间主线程不阻塞
+    common::Task<NetworkSample> sample_async(clock::duration max_age);
+
+  protected:
+    NetworkSample collect() override;
+
+  private:
+    std::string interface_;
+    int netlink_fd_ = -1;
+
+    // 网络接口信息
+    std::map<std::string, NetworkInterface> interfaces_;
+    std::string selected_interface_;
+
+    // 每个接口的流量计数器在采样批次中的下标
+    struct InterfaceStatIndices {
+        size_t rx_bytes;
+        size_t tx_bytes;
+    };
+    std::map<std::string, InterfaceStatIndices> stat_indices_;
+
+    // 带宽计算
+    uint64_t last_rx_bytes_ = 0;
+    uint64_t last_tx_bytes_ = 0;
+    uint64_t last_update_time_ = 0; // 毫秒
+
+    // 网络信息获取方法
+    // 接口扫描和无线信息查询不访问采样器的状态，可以在任意线程中调用
+    // collectors为需要运行的可选采集项（NetworkCollector）
+    static std::map<std::string, NetworkInterface> scan_network_interfaces(uint32_t collectors);
+    // 设置了数据根目录时从固定文件中读取接口列表，代替getifaddrs和无线ioctl
+    static std::map<std::string, NetworkInterface> scan_fixture_interfaces(uint32_t collectors);
+    static std::string get_ip_address(const std::string &interface, bool ipv6 = false);
+    static std::string get_wifi_ssid(const std::string &interface);
+    static void get_wifi_info(NetworkInterface &interface);
+    static bool is_wireless_interface(const std::string &ifname);
+    static void determine_interface_type(NetworkInterface &iface, uint32_t collectors);
+
+    // 采样轨迹中的接口列表：记录时把扫描结果写入轨迹，
+    // 回放时代替扫描（getifaddrs和ioctl不经过SysfsReader）
+    void record_interfaces(const std::map<std::string, NetworkInterface> &interfaces) const;
+    std::map<std::string, NetworkInterface> replay_interfaces();
+    std::string trace_key_;
+    size_t trace_cursor_ = 0;
+
+    // 读取扫描到的接口的流量计数器，选择接口并计算速率，调用时已持有锁
+    NetworkSample collect_from(std::map<std::string, NetworkInterface> interfaces);
+    void read_interface_stats();
+    void select_best_interface();
+};
+
 // 网络模块类
-class NetworkModule : public base::ModuleBase<NetworkConfig> {
+class NetworkModule : public base::ModuleBase<NetworkConfig, NetworkSample> {
   public:
     NetworkModule(
         const wbcffi_init_info *init_info, const wbcffi_config_entry *config_entries, size_t config_entries_len
@@ -89,30 +181,21 @@ class NetworkModule : public base::ModuleBase<NetworkConfig> {
     NetworkModule(NetworkModule &&) = delete;
     NetworkModule &operator=(NetworkModule &&) = delete;
 
-    // 更新函数
-    void update();
+  protected:
+    void render(const NetworkSample &sample) override;
 
-  private:
-    // 网络接口信息
-    std::map<std::string, NetworkInterface> interfaces_;
-    std::string selected_interface_;
+    // 主线程模式下通过协程采集
+    common::Task<NetworkSample> sample_async() override;
 
-    // 带宽计算
-    uint64_t last_rx_bytes_ = 0;
-    uint64_t last_tx_bytes_ = 0;
-    uint64_t last_update_time_ = 0;
+    // 未连接时显示固定提示
+    std::string render_tooltip() const override;
 
-    // 网络信息获取方法
-    void scan_network_interfaces();
-    std::string get_ip_address(const std::string &interface, bool ipv6 = false);
-    std::string get_wifi_ssid(const std::string &interface);
-    void get_wifi_info(NetworkInterface &interface);
-    void select_best_interface();
-    bool is_wireless_interface(const std::string &ifname);
-    void determine_interface_type(NetworkInterface &iface);
+  private:
+    // 最近一次渲染时是否找到了可用接口
+    bool connected_ = false;
 
-    // 流量数据格式化方法（参考原始Waybar的pow_format5w）
-    std::string pow_format5w(uint64_t bytes) const;
+    // 本实例需要信号统计：格式引用了{icon}或quality_*，或者用户配置了wireless-N状态
+    bool uses_quality_ = false;
 };
 
 } // namespace waybar::cffi::network
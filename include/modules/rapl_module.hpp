@@ -8,22 +8,30 @@
 #include <string>
 #include <chrono>
 #include <filesystem>
+#include <optional>
 #include <module_base.hpp>
 
 namespace waybar::cffi::rapl {
 
+// RAPL采样器的可选采集项
+enum RaplCollector : uint32_t {
+    COLLECT_CORE = 1u << 0, // core域的能量计数器
+};
+
 // 配置结构体 - 使用double类型的阈值
 struct RaplConfig : public base::ModuleConfigBase<double> {
     using ThresholdType = double;
 
     std::string sysfs_dir = "/sys/class/powercap/intel-rapl:0";
-    std::string format_tooltip = "Package: {package_power}W\nCore: {core_power}W\nOther: {other_power}W";
 
     RaplConfig() {
         icons["default"] = "󰟩";
         formats["default"] = "{icon}\u2004{power}W";
+        format_tooltip = "Package: {package_power}W\nCore: {core_power}W\nOther: {other_power}W";
         states["warning"] = 15.0;
         states["critical"] = 30.0;
+        format_args = {"icon", "power", "package_power", "core_power", "other_power"};
+        collector_args = {{"core_power", COLLECT_CORE}, {"other_power", COLLECT_CORE}};
     }
 
     // 重写parse_config方法以处理特定配置
@@ -33,7 +41,6 @@ struct RaplConfig : public base::ModuleConfigBase<double> {
 
         // 解析特定配置
         sysfs_dir = common::get_config_value<std::string>(config_map, "sysfs-dir", sysfs_dir);
-        format_tooltip = common::get_config_value<std::string>(config_map, "format-tooltip", format_tooltip);
     }
 };
 
@@ -51,36 +58,57 @@ struct RaplData {
         : package_energy(pkg_energy), core_energy(core_energy), timestamp(time) {}
 };
 
-// RAPL模块类
-class RaplModule : public base::ModuleBase<RaplConfig> {
-  public:
-    RaplModule(const wbcffi_init_info *init_info, const wbcffi_config_entry *config_entries, size_t config_entries_len);
-    ~RaplModule() = default;
+// 一次采样的结果
+struct RaplSample {
+    double package_power = 0.0; // 封装功耗（瓦特）
+    double core_power = 0.0;    // 核心功耗（瓦特）
+};
 
-    // 禁止拷贝和移动
-    RaplModule(const RaplModule &) = delete;
-    RaplModule &operator=(const RaplModule &) = delete;
-    RaplModule(RaplModule &&) = delete;
-    RaplModule &operator=(RaplModule &&) = delete;
+// RAPL能量计数器采样器，读取同一RAPL域的实例共享
+class RaplSampler : public base::SharedSampler<RaplSample> {
+  public:
+    // 计数器文件不存在时抛出std::runtime_error
+    RaplSampler(const std::string &sysfs_dir, common::SampleBatch::Backend backend);
 
-    // 更新函数
-    void update();
+  protected:
+    RaplSample collect() override;
 
   private:
     // RAPL数据
     RaplData prev_data_;
     bool first_update_ = true;
+    bool prev_has_core_ = false; // prev_data_中的core计数器是否有效
 
     // 缓存的max_energy_range值
     uint64_t package_max_energy_range_ = 0;
     uint64_t core_max_energy_range_ = 0;
 
+    // RAPL能量计数器在采样批次中的下标及其健康状态
+    size_t package_energy_index_ = 0;
+    size_t core_energy_index_ = 0;
+    common::SourceHealth rapl_health_{"RAPL energy counters"};
+
     // RAPL信息获取
-    RaplData get_rapl_data() const;
-    uint64_t get_energy_uj(const std::string &path) const;
+    std::optional<RaplData> get_rapl_data(common::SourceHealth::clock::time_point now, bool read_core);
     double calculate_power(uint64_t energy_diff, double time_diff_seconds) const;
 };
 
+// RAPL模块类
+class RaplModule : public base::ModuleBase<RaplConfig, RaplSample> {
+  public:
+    RaplModule(const wbcffi_init_info *init_info, const wbcffi_config_entry *config_entries, size_t config_entries_len);
+    ~RaplModule() = default;
+
+    // 禁止拷贝和移动
+    RaplModule(const RaplModule &) = delete;
+    RaplModule &operator=(const RaplModule &) = delete;
+    RaplModule(RaplModule &&) = delete;
+    RaplModule &operator=(RaplModule &&) = delete;
+
+  protected:
+    void render(const RaplSample &sample) override;
+};
+
 } // namespace waybar::cffi::rapl
 
 #endif // WAYBAR_CFFI_RAPL_MODULE_HPP
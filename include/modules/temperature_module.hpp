@@ -23,6 +23,7 @@ struct TemperatureConfig : public base::ModuleConfigBase<int> {
         format_tooltip = "Temperature: {temperature_c}°C\nFahrenheit: {temperature_f}°F\nKelvin: {temperature_k}K";
         states["warning"] = 60;
         states["critical"] = 80;
+        format_args = {"icon", "temperature_c", "temperature_f", "temperature_k"};
     }
 
     // 重写parse_config方法以处理特定配置
@@ -32,8 +33,30 @@ struct TemperatureConfig : public base::ModuleConfigBase<int> {
     }
 };
 
+// 一次采样的结果
+struct TemperatureSample {
+    float temperature_c = 0.0f; // 摄氏温度
+};
+
+// 温度传感器采样器，读取同一传感器的实例共享
+class TemperatureSampler : public base::SharedSampler<TemperatureSample> {
+  public:
+    TemperatureSampler(const std::string &hwmon_path, common::SampleBatch::Backend backend);
+
+  protected:
+    TemperatureSample collect() override;
+
+  private:
+    // 温度传感器在采样批次中的下标及其健康状态
+    size_t temperature_index_ = 0;
+    common::SourceHealth temperature_health_{"Temperature sensor"};
+
+    // 获取温度值
+    float get_temperature(common::SourceHealth::clock::time_point now);
+};
+
 // 温度模块类
-class TemperatureModule : public base::ModuleBase<TemperatureConfig> {
+class TemperatureModule : public base::ModuleBase<TemperatureConfig, TemperatureSample> {
   public:
     TemperatureModule(
         const wbcffi_init_info *init_info, const wbcffi_config_entry *config_entries, size_t config_entries_len
@@ -46,12 +69,8 @@ class TemperatureModule : public base::ModuleBase<TemperatureConfig> {
     TemperatureModule(TemperatureModule &&) = delete;
     TemperatureModule &operator=(TemperatureModule &&) = delete;
 
-    // 温度模块的更新方法
-    void update() override;
-
-  private:
-    // 获取温度值
-    float get_temperature() const;
+  protected:
+    void render(const TemperatureSample &sample) override;
 };
 
 } // namespace waybar::cffi::temperature
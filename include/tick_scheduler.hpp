@@ -0,0 +1,79 @@
+#ifndef WAYBAR_CFFI_TICK_SCHEDULER_HPP
+#define WAYBAR_CFFI_TICK_SCHEDULER_HPP
+
+#include <glib.h>
+#include <cstdint>
+#include <vector>
+
+namespace waybar::cffi::common {
+
+// 共享的周期任务调度器
+// 所有任务的触发时刻对齐到墙上时钟的整倍数（例如1000ms的任务总在整秒触发，
+// 250ms的任务在每个0.25s边界触发），
+// 同一时刻到期的任务由一次唤醒统一处理；调度器只持有一个GSource，
+// 按最早的到期时间设置唤醒时刻
+// 对齐方式只取决于墙上时钟和间隔，因此不同模块库各自的调度器也会在相同的时刻触发
+class TickScheduler {
+  public:
+    using Callback = void (*)(void *user_data);
+
+    // 每个模块库一个实例，同类模块的所有实例共享
+    static TickScheduler &instance();
+
+    TickScheduler(const TickScheduler &) = delete;
+    TickScheduler &operator=(const TickScheduler &) = delete;
+
+    // 注册周期任务，返回任务ID
+    guint add(uint32_t interval_ms, Callback callback, void *user_data);
+
+    // 移除任务，可以在任务回调中调用
+    void remove(guint id);
+
+    // 调度器被唤醒的次数
+    uint64_t wakeups() const {
+        return wakeups_;
+    }
+
+    // 任务回调被调用的总次数
+    uint64_t dispatches() const {
+        return dispatches_;
+    }
+
+    size_t task_count() const {
+        return tasks_.size();
+    }
+
+    // 严格大于t_ms的下一个interval_ms整倍数
+    static int64_t align_next(int64_t t_ms, uint32_t interval_ms);
+
+    // 墙上时钟回拨（NTP校正、休眠恢复后修正RTC）后，已对齐的时刻可能远在未来，
+    // 超过当前时刻一个间隔以上时重新对齐到当前时刻之后的边界
+    static void clamp_to_clock(int64_t &next_ms, int64_t now_ms, uint32_t interval_ms);
+
+  private:
+    struct Task {
+        guint id;
+        uint32_t interval_ms;
+        int64_t next_ms; // 下一次触发的墙上时钟时刻（毫秒）
+        Callback callback;
+        void *user_data;
+    };
+
+    TickScheduler() = default;
+    ~TickScheduler();
+
+    void dispatch();
+    void reschedule();
+    static gboolean source_dispatch(GSource *source, GSourceFunc callback, gpointer user_data);
+
+    std::vector<Task> tasks_;
+    GSource *source_ = nullptr;
+    guint next_id_ = 1;
+    bool dispatching_ = false;
+    uint64_t wakeups_ = 0;
+    uint64_t dispatches_ = 0;
+};
+
+} // namespace waybar::cffi::common
+
+#endif // WAYBAR_CFFI_TICK_SCHEDULER_HPP
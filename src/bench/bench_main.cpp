@@ -0,0 +1,342 @@
+// 微基准测试：公共热路径的耗时（ns/op）和堆分配次数（allocs/op），以及与旧实现的对照
+// sysfs和/proc/stat解析使用写入临时目录的固定输入，结果不依赖运行机器的硬件
+#include <common.hpp>
+#include <module_base.hpp>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace waybar::cffi;
+
+// 统计堆分配次数：替换全局operator new，计数在基准测试循环前后取差值
+namespace {
+std::atomic<uint64_t> allocation_count{0};
+} // namespace
+
+void *operator new(std::size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void *ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &tag) noexcept {
+    return operator new(size, tag);
+}
+
+// 不内联，否则GCC在调用处看到new/free配对时给出-Wmismatched-new-delete误报
+__attribute__((noinline)) void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+__attribute__((noinline)) void operator delete[](void *ptr) noexcept {
+    std::free(ptr);
+}
+
+__attribute__((noinline)) void operator delete(void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+__attribute__((noinline)) void operator delete[](void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+namespace {
+
+// 防止编译器优化掉被测代码
+template <typename T> inline void do_not_optimize(const T &value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// 运行一个基准测试：自动增加迭代次数直到总耗时超过约200ms，返回ns/op
+// 同时输出最后一轮的平均堆分配次数
+template <typename Fn> double run_bench(const char *name, Fn &&fn) {
+    using clock = std::chrono::steady_clock;
+    size_t iterations = 1000;
+    double elapsed_ns = 0.0;
+    uint64_t allocations = 0;
+
+    for (;;) {
+        uint64_t allocations_before = allocation_count.load(std::memory_order_relaxed);
+        auto start = clock::now();
+        for (size_t i = 0; i < iterations; ++i) {
+            fn(i);
+        }
+        elapsed_ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+        allocations = allocation_count.load(std::memory_order_relaxed) - allocations_before;
+        if (elapsed_ns > 2e8 || iterations >= (size_t(1) << 30)) {
+            break;
+        }
+        iterations *= 4;
+    }
+
+    double ns_per_op = elapsed_ns / static_cast<double>(iterations);
+    double allocs_per_op = static_cast<double>(allocations) / static_cast<double>(iterations);
+    std::printf("%-40s %12.1f ns/op %8.2f allocs/op %12zu iterations\n", name, ns_per_op, allocs_per_op,
+                iterations);
+    return ns_per_op;
+}
+
+// 优化前的实现，作为对照
+namespace legacy {
+
+std::string format_number(double value, int total_length = 4) {
+    std::ostringstream oss;
+
+    if (value >= 100.0) {
+        oss << std::fixed << std::setprecision(0) << std::round(value);
+    } else if (value >= 10.0) {
+        oss << std::fixed << std::setprecision(1) << value;
+    } else {
+        oss << std::fixed << std::setprecision(2) << value;
+    }
+
+    std::string result = oss.str();
+
+    if (result.length() > static_cast<size_t>(total_length)) {
+        result = result.substr(0, static_cast<size_t>(total_length));
+    } else if (result.length() < static_cast<size_t>(total_length)) {
+        size_t padding = static_cast<size_t>(total_length) - result.length();
+        result = std::string(padding, ' ') + result;
+    }
+
+    return result;
+}
+
+std::string pow_format5w(uint64_t bytes) {
+    const char *units = "KMGTPE";
+    int unit_idx = -1;
+    auto size = static_cast<double>(bytes);
+    auto base = 1000.0;
+
+    if (size < 10.0) {
+        return "0.00K";
+    }
+
+    while (size >= base && unit_idx < 5) {
+        size /= base;
+        unit_idx++;
+    }
+
+    if (unit_idx < 0) {
+        unit_idx = 0;
+        size /= base;
+    }
+
+    return format_number(size, 4) + std::string(1, units[unit_idx]);
+}
+
+} // namespace legacy
+
+// 典型输入：功耗/使用率等小数，以及网络流量字节数
+const std::vector<double> number_inputs = {0.0,   0.5,   3.14159, 9.995,  12.345, 45.6,
+                                           99.99, 150.2, 999.5,   2048.7, -1.25,  37.0};
+const std::vector<uint64_t> byte_inputs = {0,         7,          999,          1536,         48213,
+                                           999999,    1234567,    98765432,     1000000000,   5368709120,
+                                           1ULL << 31, 1ULL << 40, 123456789012, 1ULL << 50, 1ULL << 62};
+
+// 新旧实现的输出必须逐字节一致
+bool verify_outputs() {
+    bool ok = true;
+    for (double value : number_inputs) {
+        if (common::format_number(value) != legacy::format_number(value)) {
+            std::printf("format_number mismatch for %.17g\n", value);
+            ok = false;
+        }
+    }
+    for (uint64_t bytes : byte_inputs) {
+        if (common::pow_format5w(bytes) != legacy::pow_format5w(bytes)) {
+            std::printf("pow_format5w mismatch for %llu\n", static_cast<unsigned long long>(bytes));
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// format_string和预编译模板的典型输入
+const std::string format_input = "{icon} {usage:>3}% {freq:.2f}GHz {name}";
+const std::vector<std::pair<std::string, common::format_arg>> format_string_args = {
+    {"icon", std::string("\uf2db")}, {"usage", 42}, {"freq", 3.456}, {"name", std::string("cpu0")}
+};
+
+// 配置值的典型输入：带引号和转义序列的JSON字符串
+const std::vector<std::string> config_inputs = {
+    "\"{icon} {power:.1f}W\"", "\"Line1\\nLine2\\t\\u00b0C\"", "1000", "\"{ifname}: {bandwidthDownBytes}\"",
+    "\"\\\"quoted\\\" value\""
+};
+
+// /proc/stat的cpu汇总行
+const std::string proc_stat_line = "cpu  4705 356 584 3699176 23060 0 277 0 0 0";
+
+// 固定的sysfs/procfs输入，写入临时目录，退出时删除
+class Fixtures {
+  public:
+    Fixtures() {
+        char dir_template[] = "/tmp/waybar-cffi-bench-XXXXXX";
+        if (mkdtemp(dir_template) == nullptr) {
+            throw std::runtime_error("Failed to create fixture directory");
+        }
+        root_ = dir_template;
+        write("energy_uj", "123456789012\n");
+        write("rx_bytes", "98765432\n");
+        write("tx_bytes", "1234567\n");
+        write("temp1_input", "45000\n");
+        write("gpu_busy_percent", "37\n");
+        write("stat", proc_stat_line + "\ncpu0 1132 34 1441 11311718 3675 127 438 0 0 0\nintr 114930548\n");
+    }
+
+    ~Fixtures() {
+        std::error_code ec;
+        std::filesystem::remove_all(root_, ec);
+    }
+
+    Fixtures(const Fixtures &) = delete;
+    Fixtures &operator=(const Fixtures &) = delete;
+
+    std::string path(const std::string &name) const {
+        return (root_ / name).string();
+    }
+
+  private:
+    void write(const std::string &name, const std::string &content) {
+        std::ofstream(root_ / name) << content;
+    }
+
+    std::filesystem::path root_;
+};
+
+// 带状态阈值的配置，与模块解析配置后的结果一致
+base::ModuleConfigBase<int> make_state_config() {
+    base::ModuleConfigBase<int> config;
+    config.format_args = {"icon", "usage"};
+    config.states = {{"low", 5}, {"warning", 70}, {"critical", 90}, {"idle", 1}};
+    config.prepare();
+    return config;
+}
+
+} // namespace
+
+int main() {
+    if (!verify_outputs()) {
+        return 1;
+    }
+    common::set_log_level(common::LogLevel::Error);
+
+    const size_t numbers = number_inputs.size();
+    const size_t bytes = byte_inputs.size();
+
+    double legacy_number = run_bench("legacy::format_number", [&](size_t i) {
+        do_not_optimize(legacy::format_number(number_inputs[i % numbers]));
+    });
+    double new_number = run_bench("common::format_number", [&](size_t i) {
+        do_not_optimize(common::format_number(number_inputs[i % numbers]));
+    });
+    double new_number_to = run_bench("common::format_number_to", [&](size_t i) {
+        char buf[8];
+        do_not_optimize(common::format_number_to(buf, sizeof(buf), number_inputs[i % numbers]));
+        do_not_optimize(buf);
+    });
+
+    double legacy_pow = run_bench("legacy::pow_format5w", [&](size_t i) {
+        do_not_optimize(legacy::pow_format5w(byte_inputs[i % bytes]));
+    });
+    double new_pow = run_bench("common::pow_format5w", [&](size_t i) {
+        do_not_optimize(common::pow_format5w(byte_inputs[i % bytes]));
+    });
+    double new_pow_to = run_bench("common::pow_format5w_to", [&](size_t i) {
+        char buf[8];
+        do_not_optimize(common::pow_format5w_to(buf, sizeof(buf), byte_inputs[i % bytes]));
+        do_not_optimize(buf);
+    });
+
+    run_bench("common::format_string", [&](size_t) {
+        do_not_optimize(common::format_string(format_input, format_string_args));
+    });
+    auto format_template = common::FormatTemplate::compile(format_input, {"icon", "usage", "freq", "name"});
+    std::vector<common::format_arg> template_args;
+    for (const auto &[name, value] : format_string_args) {
+        template_args.push_back(value);
+    }
+    run_bench("common::FormatTemplate::render", [&](size_t) {
+        do_not_optimize(format_template.render(template_args));
+    });
+
+    const size_t configs = config_inputs.size();
+    run_bench("common::clean_string_value", [&](size_t i) {
+        do_not_optimize(common::clean_string_value(config_inputs[i % configs]));
+    });
+    run_bench("common::parse_escape_sequences", [&](size_t i) {
+        do_not_optimize(common::parse_escape_sequences(config_inputs[i % configs]));
+    });
+
+    // get_state的匹配部分，不包含写入GTK的CSS类
+    auto state_config = make_state_config();
+    const std::vector<double> state_inputs = {0.0, 3.0, 42.0, 75.0, 95.0, 100.0};
+    run_bench("ModuleConfigBase::match_state", [&](size_t i) {
+        do_not_optimize(state_config.match_state(state_inputs[i % state_inputs.size()], false));
+    });
+    run_bench("ModuleConfigBase::match_state (lesser)", [&](size_t i) {
+        do_not_optimize(state_config.match_state(state_inputs[i % state_inputs.size()], true));
+    });
+
+    run_bench("common::parse_cpu_stat_line", [&](size_t) {
+        common::CpuStatTimes times;
+        do_not_optimize(common::parse_cpu_stat_line(proc_stat_line, times));
+        do_not_optimize(times);
+    });
+
+    Fixtures fixtures;
+    common::SysfsReader energy_reader(fixtures.path("energy_uj"));
+    run_bench("common::SysfsReader::read_uint64", [&](size_t) {
+        do_not_optimize(energy_reader.read_uint64());
+    });
+    common::SysfsReader stat_reader(fixtures.path("stat"));
+    run_bench("/proc/stat read + parse", [&](size_t) {
+        char buf[256];
+        size_t length = stat_reader.read(buf, sizeof(buf));
+        std::string_view text(buf, length);
+        common::CpuStatTimes times;
+        do_not_optimize(common::parse_cpu_stat_line(text.substr(0, text.find('\n')), times));
+        do_not_optimize(times);
+    });
+
+    common::SampleBatch batch;
+    const char *batch_files[] = {"energy_uj", "rx_bytes", "tx_bytes", "temp1_input", "gpu_busy_percent"};
+    for (const char *name : batch_files) {
+        batch.add(fixtures.path(name));
+    }
+    run_bench("common::SampleBatch::submit (5 files)", [&](size_t) {
+        batch.submit();
+        uint64_t sum = 0;
+        for (size_t idx = 0; idx < batch.size(); ++idx) {
+            sum += batch.uint64(idx);
+        }
+        do_not_optimize(sum);
+    });
+
+    std::printf("\nformat_number speedup: %.1fx (string), %.1fx (buffer)\n", legacy_number / new_number,
+                legacy_number / new_number_to);
+    std::printf("pow_format5w speedup:  %.1fx (string), %.1fx (buffer)\n", legacy_pow / new_pow,
+                legacy_pow / new_pow_to);
+
+    return 0;
+}
@@ -7,6 +7,24 @@
 #include <chrono>
 #include <iomanip>
 #include <sstream>
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <bit>
+
+#ifdef WAYBAR_CFFI_HAVE_IO_URING
+#include <liburing.h>
+#endif
+#include <ctime>
+#include <mutex>
+#include <thread>
 
 namespace waybar::cffi::common {
 
@@ -57,32 +75,369 @@ std::string format_string(const std::string &format_str, const std::vector<std::
     }
 }
 
-// 格式化数字，确保总长度为指定字符数
-std::string format_number(double value, int total_length) {
-    std::ostringstream oss;
+// 辅助函数：UTF-8首字节对应的码点字节数
+static size_t utf8_sequence_length(unsigned char c) {
+    if (c < 0x80) {
+        return 1;
+    } else if ((c & 0xE0) == 0xC0) {
+        return 2;
+    } else if ((c & 0xF0) == 0xE0) {
+        return 3;
+    } else if ((c & 0xF8) == 0xF0) {
+        return 4;
+    }
+    return 1;
+}
+
+FormatTemplate::Spec FormatTemplate::parse_spec(std::string_view spec) {
+    Spec result;
+    result.fallback = "{:" + std::string(spec) + "}";
+
+    auto is_align = [](char c) { return c == '<' || c == '>' || c == '^'; };
+
+    size_t i = 0;
+    if (!spec.empty()) {
+        // [[fill]align]，fill可以是任意一个UTF-8字符
+        size_t fill_len = utf8_sequence_length(static_cast<unsigned char>(spec[0]));
+        if (spec.size() > fill_len && is_align(spec[fill_len])) {
+            result.fill = std::string(spec.substr(0, fill_len));
+            result.align = spec[fill_len];
+            i = fill_len + 1;
+        } else if (is_align(spec[0])) {
+            result.align = spec[0];
+            i = 1;
+        }
+    }
+
+    // 符号、'#'、'0'填充等交给fmt处理
+    if (i < spec.size() && (spec[i] == '+' || spec[i] == '-' || spec[i] == ' ' || spec[i] == '#' || spec[i] == '0')) {
+        result.native = false;
+        return result;
+    }
+
+    while (i < spec.size() && std::isdigit(static_cast<unsigned char>(spec[i]))) {
+        result.width = result.width * 10 + static_cast<size_t>(spec[i] - '0');
+        ++i;
+    }
+
+    if (i < spec.size() && spec[i] == '.') {
+        ++i;
+        if (i >= spec.size() || !std::isdigit(static_cast<unsigned char>(spec[i]))) {
+            // 动态精度等写法交给fmt处理
+            result.native = false;
+            return result;
+        }
+        result.precision = 0;
+        while (i < spec.size() && std::isdigit(static_cast<unsigned char>(spec[i]))) {
+            result.precision = result.precision * 10 + (spec[i] - '0');
+            ++i;
+        }
+    }
+
+    if (i < spec.size()) {
+        result.type = spec[i++];
+        if (result.type != 's' && result.type != 'd' && result.type != 'f') {
+            result.native = false;
+        }
+    }
+
+    if (i != spec.size()) {
+        result.native = false;
+    }
+
+    return result;
+}
+
+FormatTemplate FormatTemplate::compile(const std::string &format_str, const std::vector<std::string> &names) {
+    FormatTemplate tpl;
+    tpl.source_ = format_str;
+
+    std::string literal;
+    size_t next_auto_index = 0;
+
+    auto flush_literal = [&]() {
+        if (!literal.empty()) {
+            Op op;
+            op.text = std::move(literal);
+            tpl.ops_.push_back(std::move(op));
+            literal.clear();
+        }
+    };
+
+    for (size_t i = 0; i < format_str.size(); ++i) {
+        char c = format_str[i];
+
+        if (c == '}') {
+            if (i + 1 < format_str.size() && format_str[i + 1] == '}') {
+                literal += '}';
+                ++i;
+                continue;
+            }
+            throw std::invalid_argument("unmatched '}' in format string");
+        }
+
+        if (c != '{') {
+            literal += c;
+            continue;
+        }
+
+        if (i + 1 < format_str.size() && format_str[i + 1] == '{') {
+            literal += '{';
+            ++i;
+            continue;
+        }
+
+        size_t close = format_str.find_first_of("{}", i + 1);
+        if (close == std::string::npos || format_str[close] != '}') {
+            throw std::invalid_argument("invalid replacement field in format string");
+        }
+
+        std::string_view field(format_str.data() + i + 1, close - i - 1);
+        std::string_view name = field.substr(0, field.find(':'));
+
+        Op op;
+        op.is_literal = false;
+
+        if (name.empty()) {
+            // 自动编号 "{}"
+            op.arg = next_auto_index++;
+        } else if (std::all_of(name.begin(), name.end(), [](char ch) {
+                       return std::isdigit(static_cast<unsigned char>(ch));
+                   })) {
+            // 显式编号 "{0}"
+            op.arg = std::stoul(std::string(name));
+        } else {
+            auto it = std::find(names.begin(), names.end(), name);
+            if (it == names.end()) {
+                throw std::invalid_argument("unknown placeholder {" + std::string(name) + "}");
+            }
+            op.arg = static_cast<size_t>(it - names.begin());
+        }
+
+        if (op.arg >= names.size()) {
+            throw std::invalid_argument("argument index out of range in {" + std::string(field) + "}");
+        }
+
+        if (name.size() < field.size()) {
+            op.has_spec = true;
+            op.spec = parse_spec(field.substr(name.size() + 1));
+        }
+
+        tpl.used_args_ |= op.arg < 64 ? uint64_t(1) << op.arg : ~uint64_t(0);
+        flush_literal();
+        tpl.ops_.push_back(std::move(op));
+        i = close;
+    }
+
+    flush_literal();
+    return tpl;
+}
+
+FormatTemplate FormatTemplate::literal(const std::string &text) {
+    FormatTemplate tpl;
+    tpl.source_ = text;
+    Op op;
+    op.text = text;
+    tpl.ops_.push_back(std::move(op));
+    return tpl;
+}
+
+// 辅助函数：按支持的格式说明子集生成占位符内容，返回false表示需要交给fmt处理
+static bool format_native_body(
+    std::string &body, bool &is_number, const format_arg &value, int precision, char type, bool has_width
+) {
+    if (const auto *str = std::get_if<std::string>(&value)) {
+        is_number = false;
+        if (precision >= 0 || (type != '\0' && type != 's')) {
+            return false;
+        }
+        // 非ASCII内容的显示宽度计算交给fmt
+        if (has_width &&
+            std::any_of(str->begin(), str->end(), [](char ch) { return static_cast<unsigned char>(ch) >= 0x80; })) {
+            return false;
+        }
+        body = *str;
+        return true;
+    }
+
+    if (const auto *integer = std::get_if<int>(&value)) {
+        if (precision >= 0 || (type != '\0' && type != 'd')) {
+            return false;
+        }
+        fmt::format_int formatted(*integer);
+        body.assign(formatted.data(), formatted.size());
+        return true;
+    }
+
+    if (type != 'f') {
+        return false;
+    }
+    char buf[512];
+    auto result = std::to_chars(
+        buf, buf + sizeof(buf), std::get<double>(value), std::chars_format::fixed, precision >= 0 ? precision : 6
+    );
+    if (result.ec != std::errc()) {
+        return false;
+    }
+    body.assign(buf, result.ptr);
+    return true;
+}
+
+void FormatTemplate::append_arg(std::string &out, const Op &op, const format_arg &value) {
+    if (!op.has_spec) {
+        if (const auto *str = std::get_if<std::string>(&value)) {
+            out += *str;
+        } else if (const auto *integer = std::get_if<int>(&value)) {
+            fmt::format_int formatted(*integer);
+            out.append(formatted.data(), formatted.size());
+        } else {
+            fmt::format_to(std::back_inserter(out), "{}", std::get<double>(value));
+        }
+        return;
+    }
+
+    const Spec &spec = op.spec;
+
+    // 不支持的组合交给fmt（类型不匹配时由fmt抛出异常，与format_string行为一致）
+    std::string body;
+    bool is_number = true;
+    if (!spec.native || !format_native_body(body, is_number, value, spec.precision, spec.type, spec.width > 0)) {
+        std::visit([&](auto &&arg) { out += fmt::vformat(spec.fallback, fmt::make_format_args(arg)); }, value);
+        return;
+    }
+
+    if (body.size() >= spec.width) {
+        out += body;
+        return;
+    }
+
+    // 按对齐方式填充到指定宽度，字符串默认左对齐，数字默认右对齐
+    size_t padding = spec.width - body.size();
+    char align = spec.align != '\0' ? spec.align : (is_number ? '>' : '<');
+    size_t left = align == '>' ? padding : (align == '^' ? padding / 2 : 0);
+    size_t right = padding - left;
+
+    for (size_t i = 0; i < left; ++i) {
+        out += spec.fill;
+    }
+    out += body;
+    for (size_t i = 0; i < right; ++i) {
+        out += spec.fill;
+    }
+}
+
+std::string FormatTemplate::render(const std::vector<format_arg> &args) const {
+    std::string out;
+    out.reserve(source_.size() + 16);
+
+    for (const auto &op : ops_) {
+        if (op.is_literal) {
+            out += op.text;
+        } else if (op.arg < args.size()) {
+            append_arg(out, op, args[op.arg]);
+        } else {
+            throw std::out_of_range("missing format argument #" + std::to_string(op.arg));
+        }
+    }
+
+    return out;
+}
+
+// format_number使用的临时缓冲区大小，足以容纳DBL_MAX的定点表示
+static constexpr size_t NUMBER_SCRATCH_SIZE = 400;
+
+// 格式化数字到缓冲区，确保总长度为指定字符数
+size_t format_number_to(char *out, size_t out_size, double value, int total_length) {
+    if (out_size == 0) {
+        return 0;
+    }
 
     // 根据值的大小和所需长度动态选择精度
+    char scratch[NUMBER_SCRATCH_SIZE];
+    std::to_chars_result result;
     if (value >= 100.0) {
-        oss << std::fixed << std::setprecision(0) << std::round(value);
+        result = std::to_chars(scratch, scratch + sizeof(scratch), std::round(value), std::chars_format::fixed, 0);
     } else if (value >= 10.0) {
-        oss << std::fixed << std::setprecision(1) << value;
+        result = std::to_chars(scratch, scratch + sizeof(scratch), value, std::chars_format::fixed, 1);
     } else {
-        oss << std::fixed << std::setprecision(2) << value;
+        result = std::to_chars(scratch, scratch + sizeof(scratch), value, std::chars_format::fixed, 2);
     }
-
-    std::string result = oss.str();
+    auto length = static_cast<size_t>(result.ptr - scratch);
 
     // 强制截断或填充到指定长度（在前面填充空格，保持右对齐）
-    if (result.length() > static_cast<size_t>(total_length)) {
-        result = result.substr(0, static_cast<size_t>(total_length));
-    } else if (result.length() < static_cast<size_t>(total_length)) {
-        size_t padding = static_cast<size_t>(total_length) - result.length();
-        result = std::string(padding, ' ') + result;
+    size_t padding = 0;
+    if (total_length >= 0) {
+        auto width = static_cast<size_t>(total_length);
+        if (length > width) {
+            length = width;
+        } else {
+            padding = width - length;
+        }
     }
 
+    size_t written = 0;
+    for (; written < padding && written + 1 < out_size; ++written) {
+        out[written] = ' ';
+    }
+    size_t copy = std::min(length, out_size - 1 - written);
+    std::memcpy(out + written, scratch, copy);
+    written += copy;
+    out[written] = '\0';
+
+    return written;
+}
+
+// 格式化数字，确保总长度为指定字符数
+std::string format_number(double value, int total_length) {
+    char buf[64];
+    if (total_length >= 0 && static_cast<size_t>(total_length) < sizeof(buf)) {
+        return std::string(buf, format_number_to(buf, sizeof(buf), value, total_length));
+    }
+
+    std::string result(NUMBER_SCRATCH_SIZE + static_cast<size_t>(std::max(total_length, 0)), '\0');
+    result.resize(format_number_to(result.data(), result.size(), value, total_length));
     return result;
 }
 
+// 单位表：第i项表示达到该阈值后使用units[i]
+static constexpr std::array<double, 6> POW_FORMAT_THRESHOLDS = {0.0, 1e6, 1e9, 1e12, 1e15, 1e18};
+static constexpr std::array<char, 6> POW_FORMAT_UNITS = {'K', 'M', 'G', 'T', 'P', 'E'};
+
+// 参考原始Waybar的pow_format5w实现 - 5字符宽度的格式化
+size_t pow_format5w_to(char *out, size_t out_size, uint64_t bytes) {
+    if (out_size < 6) {
+        return 0;
+    }
+
+    auto size = static_cast<double>(bytes);
+    if (size < 10.0) {
+        std::memcpy(out, "0.00K", 6);
+        return 5;
+    }
+
+    // 查表选择单位
+    size_t unit = 0;
+    while (unit + 1 < POW_FORMAT_THRESHOLDS.size() && size >= POW_FORMAT_THRESHOLDS[unit + 1]) {
+        ++unit;
+    }
+
+    // 逐级除以1000，保证结果与逐级换算的原始实现逐位一致
+    for (size_t i = 0; i <= unit; ++i) {
+        size /= 1000.0;
+    }
+
+    // 数值部分固定4字符宽度，随后是单位
+    size_t length = format_number_to(out, out_size - 1, size, 4);
+    out[length++] = POW_FORMAT_UNITS[unit];
+    out[length] = '\0';
+    return length;
+}
+
+std::string pow_format5w(uint64_t bytes) {
+    char buf[8];
+    return std::string(buf, pow_format5w_to(buf, sizeof(buf), bytes));
+}
+
 // 辅助函数：将Unicode码点写入输出流
 static void write_unicode_code_point(std::stringstream &output, unsigned long code_point) {
     if (code_point <= 0x7F) {
@@ -104,7 +459,7 @@ static void write_unicode_code_point(std::stringstream &output, unsigned long co
     }
 }
 
-static std::string waybar_parse_escape_sequences(const std::string_view &input) {
+std::string parse_escape_sequences(std::string_view input) {
     std::stringstream output;
     bool in_escape = false;
 
@@ -241,9 +596,9 @@ std::string clean_string_value(const std::string &value) {
         result.pop_back();
     }
 
-    // 使用waybar_parse_escape_sequences处理引号和转义序列
+    // 处理引号和转义序列
     try {
-        result = waybar_parse_escape_sequences(result);
+        result = parse_escape_sequences(result);
     } catch (const std::exception &e) {
         log_warning("Error parsing escape sequences: {}", e.what());
     }
@@ -251,4 +606,1077 @@ std::string clean_string_value(const std::string &value) {
     return result;
 }
 
+// 这些错误表示fd指向的设备已被移除或重新注册，重新打开路径即可恢复
+static bool is_stale_fd_error(int error) {
+    return error == ENODEV || error == ESTALE || error == ENOENT || error == EBADF;
+}
+
+SysfsReader::~SysfsReader() {
+    close();
+}
+
+SysfsReader::SysfsReader(SysfsReader &&other) noexcept
+    : path_(std::move(other.path_)), fd_(other.fd_), syscalls_(other.syscalls_), trace_cursor_(other.trace_cursor_),
+      replayed_at_(other.replayed_at_) {
+    other.fd_ = -1;
+}
+
+SysfsReader &SysfsReader::operator=(SysfsReader &&other) noexcept {
+    if (this != &other) {
+        close();
+        path_ = std::move(other.path_);
+        fd_ = other.fd_;
+        syscalls_ = other.syscalls_;
+        trace_cursor_ = other.trace_cursor_;
+        replayed_at_ = other.replayed_at_;
+        other.fd_ = -1;
+    }
+    return *this;
+}
+
+void SysfsReader::close() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+        ++syscalls_;
+    }
+}
+
+namespace {
+
+// 去掉结尾的'/'，拼接时由绝对路径提供分隔符；"/"等价于不设置
+std::string normalize_data_root(std::string root) {
+    while (!root.empty() && root.back() == '/') {
+        root.pop_back();
+    }
+    return root;
+}
+
+struct DataRoot {
+    std::mutex mutex;
+    std::string root;
+
+    DataRoot() {
+        if (const char *env = std::getenv("WAYBAR_CFFI_DATA_ROOT")) {
+            root = normalize_data_root(env);
+        }
+    }
+};
+
+DataRoot &data_root_state() {
+    static DataRoot state;
+    return state;
+}
+
+} // namespace
+
+void set_data_root(std::string root) {
+    root = normalize_data_root(std::move(root));
+    DataRoot &state = data_root_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.root = std::move(root);
+}
+
+std::string data_root() {
+    DataRoot &state = data_root_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    return state.root;
+}
+
+std::string data_path(std::string_view path) {
+    if (path.empty() || path.front() != '/') {
+        return std::string(path);
+    }
+
+    DataRoot &state = data_root_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (state.root.empty()) {
+        return std::string(path);
+    }
+    std::string result;
+    result.reserve(state.root.size() + path.size());
+    result.append(state.root).append(path);
+    return result;
+}
+
+namespace {
+
+constexpr char TRACE_MAGIC[8] = {'W', 'B', 'C', 'T', 'R', 'A', 'C', 'E'};
+constexpr uint32_t TRACE_VERSION = 1;
+
+template <typename T> void append_raw(std::string &out, T value) {
+    out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+// 从映射的文件中按偏移读取定长字段，越界时返回false
+template <typename T> bool read_raw(const char *data, size_t size, size_t &offset, T &value) {
+    if (size - offset < sizeof(T)) {
+        return false;
+    }
+    std::memcpy(&value, data + offset, sizeof(T));
+    offset += sizeof(T);
+    return true;
+}
+
+int64_t to_trace_ns(SampleTrace::clock::time_point timestamp) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(timestamp.time_since_epoch()).count();
+}
+
+} // namespace
+
+SampleTrace &SampleTrace::instance() {
+    static SampleTrace trace;
+    return trace;
+}
+
+SampleTrace::SampleTrace() {
+    if (const char *replay_path = std::getenv("WAYBAR_CFFI_TRACE_REPLAY")) {
+        start_replay(replay_path);
+    } else if (const char *record_path = std::getenv("WAYBAR_CFFI_TRACE_RECORD")) {
+        start_recording(record_path);
+    }
+}
+
+SampleTrace::~SampleTrace() {
+    if (record_fd_ >= 0) {
+        ::close(record_fd_);
+    }
+    if (mapping_) {
+        munmap(mapping_, mapping_size_);
+    }
+}
+
+bool SampleTrace::start_recording(const std::string &path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (mode_.load(std::memory_order_relaxed) == Mode::Replay) {
+        log_warning("Already replaying trace {}, not recording to {}", replay_path_, path);
+        return false;
+    }
+    if (record_fd_ >= 0) {
+        if (path != record_path_) {
+            log_warning("Already recording trace to {}, ignoring {}", record_path_, path);
+        }
+        return path == record_path_;
+    }
+
+    record_fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (record_fd_ < 0) {
+        log_error("Failed to open trace file {}: {}", path, std::strerror(errno));
+        return false;
+    }
+
+    std::string header(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    append_raw(header, TRACE_VERSION);
+    append_raw(header, uint32_t(0));
+    if (::write(record_fd_, header.data(), header.size()) != static_cast<ssize_t>(header.size())) {
+        log_error("Failed to write trace file {}: {}", path, std::strerror(errno));
+        ::close(record_fd_);
+        record_fd_ = -1;
+        return false;
+    }
+
+    record_path_ = path;
+    mode_.store(Mode::Record, std::memory_order_release);
+    log_info("Recording sample trace to {}", path);
+    return true;
+}
+
+bool SampleTrace::start_replay(const std::string &path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (mode_.load(std::memory_order_relaxed) == Mode::Replay) {
+        if (path != replay_path_) {
+            log_warning("Already replaying trace {}, ignoring {}", replay_path_, path);
+        }
+        return path == replay_path_;
+    }
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        log_error("Failed to open trace file {}: {}", path, std::strerror(errno));
+        return false;
+    }
+    struct stat st {};
+    if (fstat(fd, &st) < 0 || st.st_size < static_cast<off_t>(sizeof(TRACE_MAGIC) + 8)) {
+        log_error("Trace file {} is empty or unreadable", path);
+        ::close(fd);
+        return false;
+    }
+    auto size = static_cast<size_t>(st.st_size);
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        log_error("Failed to map trace file {}: {}", path, std::strerror(errno));
+        return false;
+    }
+
+    const char *data = static_cast<const char *>(mapping);
+    size_t offset = sizeof(TRACE_MAGIC);
+    uint32_t version = 0;
+    uint32_t reserved = 0;
+    if (std::memcmp(data, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0 || !read_raw(data, size, offset, version) ||
+        !read_raw(data, size, offset, reserved) || version != TRACE_VERSION) {
+        log_error("{} is not a sample trace (version {})", path, TRACE_VERSION);
+        munmap(mapping, size);
+        return false;
+    }
+
+    // 一次遍历建立索引：路径ID -> 路径，路径 -> 按时间顺序的读取记录；
+    // 文件末尾不完整的记录被忽略
+    std::unordered_map<uint32_t, std::string_view> paths;
+    std::unordered_map<std::string_view, std::vector<Record>> records;
+    size_t count = 0;
+    while (offset < size) {
+        uint8_t type = 0;
+        uint32_t id = 0;
+        if (!read_raw(data, size, offset, type) || !read_raw(data, size, offset, id)) {
+            break;
+        }
+        if (type == RECORD_PATH) {
+            uint32_t length = 0;
+            if (!read_raw(data, size, offset, length) || size - offset < length) {
+                break;
+            }
+            paths[id] = std::string_view(data + offset, length);
+            offset += length;
+        } else if (type == RECORD_READ) {
+            int64_t timestamp_ns = 0;
+            uint32_t length = 0;
+            if (!read_raw(data, size, offset, timestamp_ns) || !read_raw(data, size, offset, length)) {
+                break;
+            }
+            bool ok = length != READ_FAILED;
+            size_t content_length = ok ? length : 0;
+            if (size - offset < content_length) {
+                break;
+            }
+            auto path_it = paths.find(id);
+            if (path_it != paths.end()) {
+                Record record;
+                record.timestamp = clock::time_point(std::chrono::nanoseconds(timestamp_ns));
+                record.data = std::string_view(data + offset, content_length);
+                record.ok = ok;
+                records[path_it->second].push_back(record);
+                ++count;
+            }
+            offset += content_length;
+        } else {
+            log_warning("Unknown record type {} in trace {}, ignoring the rest", type, path);
+            break;
+        }
+    }
+
+    if (record_fd_ >= 0) {
+        ::close(record_fd_);
+        record_fd_ = -1;
+    }
+    mapping_ = mapping;
+    mapping_size_ = size;
+    replay_path_ = path;
+    replay_records_ = std::move(records);
+    mode_.store(Mode::Replay, std::memory_order_release);
+    log_info("Replaying {} reads of {} files from {}", count, replay_records_.size(), path);
+    return true;
+}
+
+void SampleTrace::stop() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (record_fd_ >= 0) {
+        ::close(record_fd_);
+        record_fd_ = -1;
+    }
+    record_path_.clear();
+    path_ids_.clear();
+
+    replay_records_.clear();
+    if (mapping_) {
+        munmap(mapping_, mapping_size_);
+        mapping_ = nullptr;
+        mapping_size_ = 0;
+    }
+    replay_path_.clear();
+    mode_.store(Mode::Off, std::memory_order_release);
+}
+
+void SampleTrace::record(std::string_view path, clock::time_point timestamp, const char *data, size_t length) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (record_fd_ < 0) {
+        return;
+    }
+
+    buffer_.clear();
+    auto [it, inserted] = path_ids_.try_emplace(std::string(path), static_cast<uint32_t>(path_ids_.size()));
+    if (inserted) {
+        append_raw(buffer_, RECORD_PATH);
+        append_raw(buffer_, it->second);
+        append_raw(buffer_, static_cast<uint32_t>(path.size()));
+        buffer_.append(path);
+    }
+
+    append_raw(buffer_, RECORD_READ);
+    append_raw(buffer_, it->second);
+    append_raw(buffer_, to_trace_ns(timestamp));
+    append_raw(buffer_, data ? static_cast<uint32_t>(length) : READ_FAILED);
+    if (data) {
+        buffer_.append(data, length);
+    }
+
+    // 每条记录一次write，进程异常退出时已写入的记录仍然完整
+    if (::write(record_fd_, buffer_.data(), buffer_.size()) != static_cast<ssize_t>(buffer_.size())) {
+        log_error("Failed to write trace file {}: {}, recording stopped", record_path_, std::strerror(errno));
+        ::close(record_fd_);
+        record_fd_ = -1;
+        mode_.store(Mode::Off, std::memory_order_release);
+    }
+}
+
+bool SampleTrace::replay(std::string_view path, size_t &cursor, Record &record) const {
+    // 回放开始后索引不再修改，不需要加锁
+    auto it = replay_records_.find(path);
+    if (it == replay_records_.end() || cursor >= it->second.size()) {
+        return false;
+    }
+    record = it->second[cursor++];
+    return true;
+}
+
+void SysfsReader::open() {
+    fd_ = ::open(data_path(path_).c_str(), O_RDONLY | O_CLOEXEC);
+    ++syscalls_;
+    if (fd_ < 0) {
+        throw std::runtime_error("Failed to open " + path_ + ": " + std::strerror(errno));
+    }
+}
+
+size_t SysfsReader::replay(char *buf, size_t size) {
+    SampleTrace::Record record;
+    if (!SampleTrace::instance().replay(path_, trace_cursor_, record)) {
+        throw std::runtime_error("No more recorded reads of " + path_);
+    }
+    replayed_at_ = record.timestamp;
+    if (!record.ok) {
+        throw std::runtime_error("Failed to read " + path_ + " (recorded)");
+    }
+
+    size_t length = std::min(record.data.size(), size - 1);
+    std::memcpy(buf, record.data.data(), length);
+    buf[length] = '\0';
+    return length;
+}
+
+size_t SysfsReader::read(char *buf, size_t size) {
+    if (size == 0) {
+        return 0;
+    }
+
+    SampleTrace &trace = SampleTrace::instance();
+    if (trace.replaying()) {
+        return replay(buf, size);
+    }
+    if (trace.recording()) {
+        try {
+            size_t length = read_file(buf, size);
+            trace.record(path_, SampleTrace::clock::now(), buf, length);
+            return length;
+        } catch (const std::exception &) {
+            trace.record(path_, SampleTrace::clock::now(), nullptr, 0);
+            throw;
+        }
+    }
+    return read_file(buf, size);
+}
+
+size_t SysfsReader::read_file(char *buf, size_t size) {
+    if (fd_ < 0) {
+        open();
+    }
+
+    ssize_t n = ::pread(fd_, buf, size - 1, 0);
+    ++syscalls_;
+    if (n < 0 && is_stale_fd_error(errno)) {
+        // 设备被移除或重新注册，旧fd已失效，重新打开后再试一次
+        close();
+        open();
+        n = ::pread(fd_, buf, size - 1, 0);
+        ++syscalls_;
+    }
+    if (n < 0) {
+        throw std::runtime_error("Failed to read " + path_ + ": " + std::strerror(errno));
+    }
+
+    auto length = static_cast<size_t>(n);
+    buf[length] = '\0';
+    return length;
+}
+
+// 跳过前导空白后用from_chars解析整数
+template <typename T> static T parse_leading_integer(const char *begin, const char *end, const std::string &path) {
+    while (begin < end && std::isspace(static_cast<unsigned char>(*begin))) {
+        ++begin;
+    }
+
+    T value{};
+    auto [ptr, ec] = std::from_chars(begin, end, value);
+    if (ec != std::errc() || ptr == begin) {
+        throw std::runtime_error("Failed to parse integer from " + path);
+    }
+    return value;
+}
+
+uint64_t SysfsReader::read_uint64() {
+    char buf[32];
+    size_t length = read(buf, sizeof(buf));
+    return parse_leading_integer<uint64_t>(buf, buf + length, path_);
+}
+
+int64_t SysfsReader::read_int64() {
+    char buf[32];
+    size_t length = read(buf, sizeof(buf));
+    return parse_leading_integer<int64_t>(buf, buf + length, path_);
+}
+
+#ifdef WAYBAR_CFFI_HAVE_IO_URING
+// io_uring实例及已注册的固定文件表
+struct SampleBatch::IoUringState {
+    struct io_uring ring {};
+    unsigned depth = 0;
+    std::vector<int> fds;        // 本次采样的fd表，下标与entries_一致
+    std::vector<int> registered; // 已注册到内核的fd表
+    bool files_registered = false;
+    bool files_dirty = false; // 有文件被重新打开，需要重新注册
+    bool use_fixed_files = true;
+
+    ~IoUringState() {
+        if (depth > 0) {
+            io_uring_queue_exit(&ring);
+        }
+    }
+
+    // 保证队列至少能容纳entries个请求，必要时重建队列（已注册的文件随之失效）
+    int reserve(unsigned entries) {
+        if (entries <= depth) {
+            return 0;
+        }
+        if (depth > 0) {
+            io_uring_queue_exit(&ring);
+            depth = 0;
+            files_registered = false;
+            registered.clear();
+        }
+        unsigned new_depth = std::bit_ceil(std::max(entries, 16u));
+        int ret = io_uring_queue_init(new_depth, &ring, 0);
+        if (ret == 0) {
+            depth = new_depth;
+        }
+        return ret;
+    }
+};
+#else
+struct SampleBatch::IoUringState {};
+#endif
+
+SampleBatch::SampleBatch() = default;
+SampleBatch::~SampleBatch() = default;
+
+SampleBatch::Backend SampleBatch::parse_backend(const std::string &name) {
+    if (name == "io_uring" || name == "io-uring") {
+        return Backend::IoUring;
+    }
+    if (name != "pread") {
+        log_warning("Unknown io-backend '{}', using pread", name);
+    }
+    return Backend::Pread;
+}
+
+const char *SampleBatch::backend_name(Backend backend) {
+    return backend == Backend::IoUring ? "io_uring" : "pread";
+}
+
+SampleBatch::Backend SampleBatch::set_backend(Backend backend) {
+    uring_.reset();
+    backend_ = Backend::Pread;
+    if (backend == Backend::Pread) {
+        return backend_;
+    }
+
+#ifdef WAYBAR_CFFI_HAVE_IO_URING
+    auto state = std::make_unique<IoUringState>();
+    int ret = state->reserve(static_cast<unsigned>(entries_.size()));
+    if (ret < 0) {
+        log_warning("io_uring unavailable ({}), falling back to pread", std::strerror(-ret));
+        return backend_;
+    }
+    uring_ = std::move(state);
+    backend_ = Backend::IoUring;
+#else
+    log_warning("io_uring support was not compiled in, falling back to pread");
+#endif
+    return backend_;
+}
+
+size_t SampleBatch::add(std::string path, size_t buffer_size) {
+    Entry entry;
+    entry.reader = SysfsReader(std::move(path));
+    entry.buffer.resize(std::max<size_t>(buffer_size, 2));
+    entries_.push_back(std::move(entry));
+    return entries_.size() - 1;
+}
+
+void SampleBatch::clear() {
+    entries_.clear();
+}
+
+uint64_t SampleBatch::syscall_count() const {
+    uint64_t count = uring_syscalls_;
+    for (const Entry &entry : entries_) {
+        count += entry.reader.syscalls();
+    }
+    return count;
+}
+
+void SampleBatch::read_entry(Entry &entry) {
+    try {
+        entry.length = entry.reader.read(entry.buffer.data(), entry.buffer.size());
+        entry.state = EntryState::Ok;
+    } catch (const std::exception &e) {
+        entry.state = EntryState::Failed;
+        entry.error = e.what();
+    }
+}
+
+void SampleBatch::submit_pread() {
+    for (Entry &entry : entries_) {
+        if (entry.enabled) {
+            read_entry(entry);
+        } else {
+            entry.state = EntryState::Skipped;
+        }
+    }
+}
+
+bool SampleBatch::submit_io_uring() {
+#ifdef WAYBAR_CFFI_HAVE_IO_URING
+    IoUringState &state = *uring_;
+
+    // 打开所有启用的文件，打开失败的直接记为失败
+    state.fds.assign(entries_.size(), -1);
+    unsigned pending = 0;
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        Entry &entry = entries_[i];
+        bool was_open = entry.reader.is_open();
+        if (!entry.enabled) {
+            entry.state = EntryState::Skipped;
+            state.fds[i] = was_open ? entry.reader.fd() : -1;
+            continue;
+        }
+        try {
+            state.fds[i] = entry.reader.fd();
+            state.files_dirty = state.files_dirty || !was_open;
+            entry.state = EntryState::Pending;
+            ++pending;
+        } catch (const std::exception &e) {
+            entry.state = EntryState::Failed;
+            entry.error = e.what();
+        }
+    }
+    if (pending == 0) {
+        return true;
+    }
+
+    int ret = state.reserve(pending);
+    if (ret < 0) {
+        log_warning("Failed to resize io_uring queue: {}", std::strerror(-ret));
+        return false;
+    }
+
+    // fd表变化时重新注册固定文件，之后的读取不再需要内核查找fd
+    if (state.use_fixed_files && (!state.files_registered || state.files_dirty || state.fds != state.registered)) {
+        if (state.files_registered) {
+            io_uring_unregister_files(&state.ring);
+            ++uring_syscalls_;
+            state.files_registered = false;
+        }
+        ret = io_uring_register_files(&state.ring, state.fds.data(), static_cast<unsigned>(state.fds.size()));
+        ++uring_syscalls_;
+        if (ret < 0) {
+            log_warning("Failed to register files with io_uring ({}), using plain fds", std::strerror(-ret));
+            state.use_fixed_files = false;
+        } else {
+            state.files_registered = true;
+            state.registered = state.fds;
+        }
+        state.files_dirty = false;
+    }
+
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        Entry &entry = entries_[i];
+        if (entry.state != EntryState::Pending) {
+            continue;
+        }
+        struct io_uring_sqe *sqe = io_uring_get_sqe(&state.ring);
+        auto length = static_cast<unsigned>(entry.buffer.size() - 1);
+        if (state.files_registered) {
+            io_uring_prep_read(sqe, static_cast<int>(i), entry.buffer.data(), length, 0);
+            io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+        } else {
+            io_uring_prep_read(sqe, state.fds[i], entry.buffer.data(), length, 0);
+        }
+        sqe->user_data = i;
+    }
+
+    // 一次系统调用提交全部读取并等待它们完成
+    ret = io_uring_submit_and_wait(&state.ring, pending);
+    ++uring_syscalls_;
+    if (ret < 0) {
+        log_warning("io_uring submission failed: {}", std::strerror(-ret));
+        return false;
+    }
+
+    unsigned head;
+    unsigned completed = 0;
+    struct io_uring_cqe *cqe;
+    io_uring_for_each_cqe(&state.ring, head, cqe) {
+        Entry &entry = entries_[static_cast<size_t>(cqe->user_data)];
+        if (cqe->res >= 0) {
+            entry.length = static_cast<size_t>(cqe->res);
+            entry.buffer[entry.length] = '\0';
+            entry.state = EntryState::Ok;
+        } else if (is_stale_fd_error(-cqe->res)) {
+            // 设备被重新注册，用pread路径重新打开，下次采样时重新注册文件表
+            read_entry(entry);
+            state.files_dirty = true;
+        } else {
+            entry.state = EntryState::Failed;
+            entry.error = "Failed to read " + entry.reader.path() + ": " + std::strerror(-cqe->res);
+        }
+        ++completed;
+    }
+    io_uring_cq_advance(&state.ring, completed);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void SampleBatch::submit() {
+    auto start = std::chrono::steady_clock::now();
+    uint64_t syscalls_before = syscall_count();
+    sampled_at_ = start;
+
+    const SampleTrace &trace = SampleTrace::instance();
+    if (trace.replaying() || trace.recording()) {
+        // 轨迹在SysfsReader中记录和回放，不经过io_uring
+        submit_pread();
+        if (trace.replaying()) {
+            sampled_at_ = {};
+            for (const Entry &entry : entries_) {
+                if (entry.state != EntryState::Skipped) {
+                    sampled_at_ = std::max(sampled_at_, entry.reader.replayed_at());
+                }
+            }
+        }
+    } else {
+        if (backend_ == Backend::IoUring && !submit_io_uring()) {
+            log_warning("io_uring sampling failed, falling back to pread");
+            uring_.reset();
+            backend_ = Backend::Pread;
+        }
+        if (backend_ == Backend::Pread) {
+            submit_pread();
+        }
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    auto latency_ns = static_cast<uint64_t>(elapsed.count());
+    stats_.ticks++;
+    stats_.last_syscalls = syscall_count() - syscalls_before;
+    stats_.syscalls += stats_.last_syscalls;
+    stats_.last_latency_ns = latency_ns;
+    stats_.total_latency_ns += latency_ns;
+    stats_.max_latency_ns = std::max(stats_.max_latency_ns, latency_ns);
+    stats_.last_reads = static_cast<uint64_t>(std::count_if(entries_.begin(), entries_.end(), [](const Entry &entry) {
+        return entry.state != EntryState::Skipped;
+    }));
+    stats_.reads += stats_.last_reads;
+}
+
+std::string_view SampleBatch::text(size_t index) const {
+    const Entry &entry = entries_[index];
+    switch (entry.state) {
+    case EntryState::Ok:
+        return std::string_view(entry.buffer.data(), entry.length);
+    case EntryState::Failed:
+        throw std::runtime_error(entry.error);
+    default:
+        throw std::runtime_error(entry.reader.path() + " was not sampled");
+    }
+}
+
+uint64_t SampleBatch::uint64(size_t index) const {
+    std::string_view content = text(index);
+    return parse_leading_integer<uint64_t>(
+        content.data(), content.data() + content.size(), entries_[index].reader.path()
+    );
+}
+
+int64_t SampleBatch::int64(size_t index) const {
+    std::string_view content = text(index);
+    return parse_leading_integer<int64_t>(
+        content.data(), content.data() + content.size(), entries_[index].reader.path()
+    );
+}
+
+void SampleBatch::log_stats() const {
+    double ticks = stats_.ticks > 0 ? static_cast<double>(stats_.ticks) : 1.0;
+    log_info(
+        "Sampling stats: backend={} files={} ticks={} sources/tick={:.1f} (last {}) syscalls/tick={:.1f} (last {}) "
+        "latency avg={:.1f}us last={:.1f}us max={:.1f}us",
+        backend_name(backend_), entries_.size(), stats_.ticks, static_cast<double>(stats_.reads) / ticks,
+        stats_.last_reads, static_cast<double>(stats_.syscalls) / ticks, stats_.last_syscalls,
+        static_cast<double>(stats_.total_latency_ns) / ticks / 1000.0,
+        static_cast<double>(stats_.last_latency_ns) / 1000.0, static_cast<double>(stats_.max_latency_ns) / 1000.0
+    );
+}
+
+size_t LatencyHistogram::bucket_index(uint64_t value) {
+    if (value < SUB_BUCKETS) {
+        return static_cast<size_t>(value);
+    }
+    // 最高位决定区间，其后的SUB_BUCKET_BITS位决定子桶
+    unsigned exponent = static_cast<unsigned>(std::bit_width(value)) - 1;
+    unsigned shift = exponent - SUB_BUCKET_BITS;
+    size_t sub_bucket = static_cast<size_t>(value >> shift) & (SUB_BUCKETS - 1);
+    return SUB_BUCKETS + (exponent - SUB_BUCKET_BITS) * SUB_BUCKETS + sub_bucket;
+}
+
+uint64_t LatencyHistogram::bucket_upper_bound(size_t index) {
+    if (index < SUB_BUCKETS) {
+        return index;
+    }
+    size_t shift = (index - SUB_BUCKETS) / SUB_BUCKETS;
+    uint64_t sub_bucket = (index - SUB_BUCKETS) % SUB_BUCKETS;
+    uint64_t lower = (SUB_BUCKETS + sub_bucket) << shift;
+    return lower + ((uint64_t(1) << shift) - 1);
+}
+
+void LatencyHistogram::record(uint64_t value) {
+    buckets_[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    uint64_t current = max_.load(std::memory_order_relaxed);
+    while (value > current && !max_.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+uint64_t LatencyHistogram::percentile(double q) const {
+    uint64_t count = count_.load(std::memory_order_relaxed);
+    uint64_t max = max_.load(std::memory_order_relaxed);
+    if (count == 0) {
+        return 0;
+    }
+    // 最近秩：第ceil(q*count)个记录所在的桶
+    auto rank = static_cast<uint64_t>(std::ceil(std::clamp(q, 0.0, 1.0) * static_cast<double>(count)));
+    rank = std::max<uint64_t>(rank, 1);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            return std::min(bucket_upper_bound(i), max);
+        }
+    }
+    return max;
+}
+
+namespace {
+
+uint64_t clock_ns(clockid_t clock) {
+    timespec ts{};
+    clock_gettime(clock, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+} // namespace
+
+CostScope::CostScope(CostStats &stats, bool measure_cpu)
+    : stats_(stats), measure_cpu_(measure_cpu), start_ns_(clock_ns(CLOCK_MONOTONIC)),
+      start_cpu_ns_(measure_cpu ? clock_ns(CLOCK_THREAD_CPUTIME_ID) : 0) {}
+
+CostScope::~CostScope() {
+    if (measure_cpu_) {
+        stats_.cpu_ns.fetch_add(clock_ns(CLOCK_THREAD_CPUTIME_ID) - start_cpu_ns_, std::memory_order_relaxed);
+        stats_.cpu_samples.fetch_add(1, std::memory_order_relaxed);
+    }
+    stats_.latency_us.record((clock_ns(CLOCK_MONOTONIC) - start_ns_) / 1000);
+}
+
+bool parse_cpu_stat_line(std::string_view line, CpuStatTimes &times) {
+    constexpr std::string_view prefix = "cpu ";
+    if (line.substr(0, prefix.size()) != prefix) {
+        return false;
+    }
+
+    // user nice system idle iowait irq softirq steal guest guest_nice
+    uint64_t fields[10];
+    const char *ptr = line.data() + prefix.size();
+    const char *end = line.data() + line.size();
+    for (uint64_t &field : fields) {
+        while (ptr < end && *ptr == ' ') {
+            ++ptr;
+        }
+        auto result = std::from_chars(ptr, end, field);
+        if (result.ec != std::errc() || result.ptr == ptr) {
+            return false;
+        }
+        ptr = result.ptr;
+    }
+
+    times.idle = fields[3] + fields[4];
+    times.total = 0;
+    for (uint64_t field : fields) {
+        times.total += field;
+    }
+    return true;
+}
+
+SourceHealth::SourceHealth(
+    std::string name, clock::duration min_backoff, clock::duration max_backoff, clock::duration summary_interval
+)
+    : name_(std::move(name)), min_backoff_(min_backoff), max_backoff_(max_backoff),
+      summary_interval_(summary_interval) {}
+
+void SourceHealth::record_failure(const std::string &error, clock::time_point now) {
+    ++consecutive_failures_;
+    ++error_count_;
+
+    // 退避时间从min_backoff开始每次翻倍，不超过max_backoff
+    clock::duration backoff = min_backoff_;
+    for (uint32_t i = 1; i < consecutive_failures_ && backoff < max_backoff_; ++i) {
+        backoff *= 2;
+    }
+    next_attempt_ = now + std::min(backoff, max_backoff_);
+
+    if (error != last_error_) {
+        // 新的错误：先输出上一条错误被合并的次数，再输出本条
+        if (suppressed_ > 0) {
+            log_warning("{}: previous error repeated {} more time(s): {}", name_, suppressed_, last_error_);
+        }
+        log_error("{}: {}", name_, error);
+        last_error_ = error;
+        suppressed_ = 0;
+        last_report_ = now;
+    } else {
+        ++suppressed_;
+        if (now - last_report_ >= summary_interval_) {
+            auto retry_s = std::chrono::duration_cast<std::chrono::seconds>(next_attempt_ - now).count();
+            log_warning(
+                "{}: still failing ({} consecutive failures, retry in {}s): {}", name_, consecutive_failures_,
+                retry_s, error
+            );
+            suppressed_ = 0;
+            last_report_ = now;
+        }
+    }
+}
+
+void SourceHealth::recovered() {
+    log_info("{}: recovered after {} failed attempt(s)", name_, consecutive_failures_);
+    consecutive_failures_ = 0;
+    last_error_.clear();
+    suppressed_ = 0;
+}
+
+// ================= 异步日志 =================
+
+namespace detail {
+std::atomic<int> log_level{static_cast<int>(LogLevel::Info)};
+} // namespace detail
+
+namespace {
+
+constexpr size_t LOG_RING_SIZE = 256; // 必须是2的幂
+constexpr size_t LOG_MESSAGE_SIZE = 240;
+
+// 环形缓冲区中的一条消息，sequence用于生产者/消费者之间的无锁交接
+struct LogSlot {
+    std::atomic<size_t> sequence{0};
+    int64_t timestamp_ms = 0;
+    LogLevel level = LogLevel::Info;
+    size_t length = 0;
+    char text[LOG_MESSAGE_SIZE];
+};
+
+// 有界多生产者环形队列 + 后台输出线程
+// 入队只有几次原子操作和一次memcpy，不加锁也不做I/O；队列满时丢弃消息并计数
+class AsyncLogger {
+  public:
+    AsyncLogger() {
+        for (size_t i = 0; i < LOG_RING_SIZE; ++i) {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~AsyncLogger() {
+        if (writer_.joinable()) {
+            stopping_.store(true, std::memory_order_release);
+            wake();
+            writer_.join();
+        }
+    }
+
+    void push(LogLevel level, std::string_view message) {
+        std::call_once(started_, [this]() { writer_ = std::thread(&AsyncLogger::run, this); });
+
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        LogSlot *slot = nullptr;
+        for (;;) {
+            slot = &slots_[pos & (LOG_RING_SIZE - 1)];
+            size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                // 队列已满，输出线程跟不上（例如stderr管道被阻塞）
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        slot->timestamp_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                 std::chrono::system_clock::now().time_since_epoch()
+        )
+                                 .count();
+        slot->level = level;
+        slot->length = std::min(message.size(), LOG_MESSAGE_SIZE);
+        std::memcpy(slot->text, message.data(), slot->length);
+        slot->sequence.store(pos + 1, std::memory_order_release);
+
+        wake();
+    }
+
+  private:
+    void wake() {
+        wakeups_.fetch_add(1, std::memory_order_release);
+        wakeups_.notify_one();
+    }
+
+    void run() {
+        for (;;) {
+            uint32_t seen = wakeups_.load(std::memory_order_acquire);
+            drain();
+            if (stopping_.load(std::memory_order_acquire)) {
+                drain();
+                return;
+            }
+            wakeups_.wait(seen, std::memory_order_acquire);
+        }
+    }
+
+    // 输出所有已就绪的消息，只在输出线程中调用
+    void drain() {
+        bool wrote_info = false;
+        for (;;) {
+            LogSlot &slot = slots_[dequeue_pos_ & (LOG_RING_SIZE - 1)];
+            if (slot.sequence.load(std::memory_order_acquire) != dequeue_pos_ + 1) {
+                break;
+            }
+
+            write_line(slot.level, slot.timestamp_ms, std::string_view(slot.text, slot.length));
+            wrote_info = wrote_info || slot.level == LogLevel::Info;
+
+            slot.sequence.store(dequeue_pos_ + LOG_RING_SIZE, std::memory_order_release);
+            ++dequeue_pos_;
+        }
+
+        uint64_t dropped = dropped_.exchange(0, std::memory_order_relaxed);
+        if (dropped > 0) {
+            auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()
+            );
+            std::string notice = fmt::format("Log buffer full, dropped {} message(s)", dropped);
+            write_line(LogLevel::Warning, now.count(), notice);
+        }
+
+        // stdout可能是全缓冲的管道，批量输出后再刷新
+        if (wrote_info) {
+            fflush(stdout);
+        }
+    }
+
+    static void write_line(LogLevel level, int64_t timestamp_ms, std::string_view message) {
+        time_t seconds = static_cast<time_t>(timestamp_ms / 1000);
+        struct tm local_time {};
+        localtime_r(&seconds, &local_time);
+
+        char timestamp[32];
+        size_t length = strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", &local_time);
+        snprintf(timestamp + length, sizeof(timestamp) - length, ".%03d", static_cast<int>(timestamp_ms % 1000));
+
+        // 使用ANSI颜色代码：红色表示错误，黄色表示警告，绿色表示信息
+        auto text_length = static_cast<int>(message.size());
+        switch (level) {
+        case LogLevel::Error:
+            fprintf(stderr, "[%s] [\033[0;31merror\033[0m] %.*s\n", timestamp, text_length, message.data());
+            break;
+        case LogLevel::Warning:
+            fprintf(stderr, "[%s] [\033[0;33mwarning\033[0m] %.*s\n", timestamp, text_length, message.data());
+            break;
+        default:
+            fprintf(stdout, "[%s] [\033[0;32minfo\033[0m] %.*s\n", timestamp, text_length, message.data());
+            break;
+        }
+    }
+
+    std::array<LogSlot, LOG_RING_SIZE> slots_;
+    alignas(64) std::atomic<size_t> enqueue_pos_{0};
+    alignas(64) size_t dequeue_pos_ = 0; // 只由输出线程访问
+    std::atomic<uint32_t> wakeups_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<bool> stopping_{false};
+    std::once_flag started_;
+    std::thread writer_;
+};
+
+AsyncLogger &logger() {
+    static AsyncLogger instance;
+    return instance;
+}
+
+} // namespace
+
+void detail::log_enqueue(LogLevel level, fmt::string_view format, fmt::format_args args) {
+    // 先在栈上格式化，超长消息在入队时截断
+    fmt::basic_memory_buffer<char, LOG_MESSAGE_SIZE> buffer;
+    try {
+        fmt::vformat_to(fmt::appender(buffer), format, args);
+    } catch (const std::exception &e) {
+        buffer.clear();
+        fmt::format_to(fmt::appender(buffer), "Failed to format log message: {}", e.what());
+    }
+    logger().push(level, std::string_view(buffer.data(), buffer.size()));
+}
+
+void set_log_level(LogLevel level) {
+    detail::log_level.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+LogLevel parse_log_level(const std::string &name, LogLevel fallback) {
+    std::string lower = name;
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+
+    if (lower == "off" || lower == "none") {
+        return LogLevel::Off;
+    } else if (lower == "error") {
+        return LogLevel::Error;
+    } else if (lower == "warning" || lower == "warn") {
+        return LogLevel::Warning;
+    } else if (lower == "info") {
+        return LogLevel::Info;
+    }
+
+    log_warning("Unknown log level '{}'", name);
+    return fallback;
+}
+
 } // namespace waybar::cffi::common
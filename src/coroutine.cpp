@@ -0,0 +1,141 @@
+#include <coroutine.hpp>
+#include <glib-unix.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace waybar::cffi::common {
+
+namespace {
+
+// 执行offload任务的后台线程，第一次提交任务时启动，卸载模块库时退出
+class OffloadWorker {
+  public:
+    static OffloadWorker &instance() {
+        static OffloadWorker worker;
+        return worker;
+    }
+
+    void submit(std::shared_ptr<detail::OffloadState> state) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!thread_.joinable()) {
+            thread_ = std::thread([this]() { run(); });
+        }
+        queue_.push_back(std::move(state));
+        cv_.notify_one();
+    }
+
+  private:
+    OffloadWorker() = default;
+
+    ~OffloadWorker() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_one();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    void run() {
+        while (true) {
+            std::shared_ptr<detail::OffloadState> state;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+                if (queue_.empty()) {
+                    return;
+                }
+                state = std::move(queue_.front());
+                queue_.pop_front();
+            }
+
+            state->job();
+            state->done.store(true, std::memory_order_release);
+            state->done.notify_all();
+
+            // g_main_context_invoke_full在其他线程中调用时添加一个空闲源，由主线程执行恢复
+            g_main_context_invoke_full(
+                nullptr, G_PRIORITY_DEFAULT, resume, new std::shared_ptr<detail::OffloadState>(std::move(state)),
+                release
+            );
+        }
+    }
+
+    static gboolean resume(gpointer user_data) {
+        auto &state = *static_cast<std::shared_ptr<detail::OffloadState> *>(user_data);
+        // 协程在等待期间被销毁时不再恢复
+        if (!state->cancelled) {
+            state->handle.resume();
+        }
+        return G_SOURCE_REMOVE;
+    }
+
+    static void release(gpointer user_data) {
+        delete static_cast<std::shared_ptr<detail::OffloadState> *>(user_data);
+    }
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::shared_ptr<detail::OffloadState>> queue_;
+    std::thread thread_;
+    bool stop_ = false;
+};
+
+} // namespace
+
+namespace detail {
+
+void offload_submit(std::shared_ptr<OffloadState> state) {
+    OffloadWorker::instance().submit(std::move(state));
+}
+
+void offload_wait(OffloadState &state) {
+    state.done.wait(false, std::memory_order_acquire);
+}
+
+} // namespace detail
+
+FdAwaiter::~FdAwaiter() {
+    if (source_id_ > 0) {
+        g_source_remove(source_id_);
+    }
+}
+
+void FdAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    handle_ = handle;
+    source_id_ = g_unix_fd_add_full(G_PRIORITY_DEFAULT, fd_, condition_, dispatch, this, nullptr);
+}
+
+gboolean FdAwaiter::dispatch(gint fd, GIOCondition condition, gpointer user_data) {
+    (void)fd;
+    auto *awaiter = static_cast<FdAwaiter *>(user_data);
+    awaiter->source_id_ = 0;
+    awaiter->revents_ = condition;
+    // 恢复之后协程可能已经结束，awaiter随协程帧一起销毁，不能再访问
+    awaiter->handle_.resume();
+    return G_SOURCE_REMOVE;
+}
+
+SleepAwaiter::~SleepAwaiter() {
+    if (source_id_ > 0) {
+        g_source_remove(source_id_);
+    }
+}
+
+void SleepAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    handle_ = handle;
+    source_id_ = g_timeout_add_full(G_PRIORITY_DEFAULT, guint(duration_.count()), dispatch, this, nullptr);
+}
+
+gboolean SleepAwaiter::dispatch(gpointer user_data) {
+    auto *awaiter = static_cast<SleepAwaiter *>(user_data);
+    awaiter->source_id_ = 0;
+    awaiter->handle_.resume();
+    return G_SOURCE_REMOVE;
+}
+
+} // namespace waybar::cffi::common
@@ -0,0 +1,170 @@
+#include <fd_registry.hpp>
+#include <common.hpp>
+#include <glib-unix.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+namespace waybar::cffi::common {
+
+namespace {
+
+// 一次epoll_wait最多取出的事件数，更多的就绪fd留到下一次主循环迭代
+constexpr int MAX_EVENTS = 32;
+
+// 注册表使用的GSource，携带所属注册表
+struct RegistrySource {
+    GSource source;
+    FdRegistry *registry;
+};
+
+} // namespace
+
+FdRegistry &FdRegistry::instance() {
+    static FdRegistry registry;
+    return registry;
+}
+
+FdRegistry::~FdRegistry() {
+    if (source_) {
+        g_source_destroy(source_);
+        g_source_unref(source_);
+        source_ = nullptr;
+    }
+    if (epoll_fd_ >= 0) {
+        close(epoll_fd_);
+        epoll_fd_ = -1;
+    }
+}
+
+guint FdRegistry::add(int fd, uint32_t events, Callback callback) {
+    if (epoll_fd_ < 0) {
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd_ < 0) {
+            log_warning("Failed to create epoll instance: {}", strerror(errno));
+            return 0;
+        }
+    }
+
+    guint id = next_id_++;
+    watches_[id] = Watch{fd, events, std::move(callback), false};
+
+    // 不支持epoll的fd（例如普通文件）注册失败
+    if (!update_interest(fd)) {
+        log_warning("Failed to watch fd {}: {}", fd, strerror(errno));
+        watches_.erase(id);
+        return 0;
+    }
+
+    if (!source_) {
+        static GSourceFuncs funcs = {nullptr, nullptr, source_dispatch, nullptr, nullptr, nullptr};
+        source_ = g_source_new(&funcs, sizeof(RegistrySource));
+        reinterpret_cast<RegistrySource *>(source_)->registry = this;
+        g_source_set_name(source_, "waybar-cffi-fd");
+        g_source_add_unix_fd(source_, epoll_fd_, G_IO_IN);
+        g_source_attach(source_, nullptr);
+    }
+    return id;
+}
+
+void FdRegistry::remove(guint id) {
+    auto it = watches_.find(id);
+    if (it == watches_.end()) {
+        return;
+    }
+
+    if (dispatching_) {
+        // 正在遍历监听表，先标记，分发结束后统一清理
+        it->second.removed = true;
+        return;
+    }
+
+    int fd = it->second.fd;
+    watches_.erase(it);
+    update_interest(fd);
+
+    if (watches_.empty() && source_) {
+        g_source_destroy(source_);
+        g_source_unref(source_);
+        source_ = nullptr;
+    }
+}
+
+bool FdRegistry::update_interest(int fd) {
+    uint32_t events = 0;
+    bool watched = false;
+    for (const auto &[id, watch] : watches_) {
+        if (watch.fd == fd && !watch.removed) {
+            events |= watch.events;
+            watched = true;
+        }
+    }
+
+    if (!watched) {
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+        return true;
+    }
+
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = fd;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &event) == 0) {
+        return true;
+    }
+    return errno == ENOENT && epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+void FdRegistry::dispatch() {
+    epoll_event events[MAX_EVENTS];
+    int ready = epoll_wait(epoll_fd_, events, MAX_EVENTS, 0);
+    if (ready <= 0) {
+        return;
+    }
+
+    ++wakeups_;
+    dispatching_ = true;
+
+    // 回调中可能添加或移除监听；std::map的插入不会使迭代器失效，移除推迟到分发结束
+    for (int i = 0; i < ready; ++i) {
+        int fd = events[i].data.fd;
+        for (auto &[id, watch] : watches_) {
+            uint32_t matched = events[i].events & (watch.events | EPOLLERR | EPOLLHUP);
+            if (watch.fd != fd || watch.removed || matched == 0) {
+                continue;
+            }
+            ++dispatches_;
+            watch.callback(matched);
+        }
+    }
+
+    dispatching_ = false;
+
+    std::vector<int> removed_fds;
+    std::erase_if(watches_, [&removed_fds](const auto &entry) {
+        if (!entry.second.removed) {
+            return false;
+        }
+        removed_fds.push_back(entry.second.fd);
+        return true;
+    });
+    for (int fd : removed_fds) {
+        update_interest(fd);
+    }
+
+    if (watches_.empty() && source_) {
+        g_source_destroy(source_);
+        g_source_unref(source_);
+        source_ = nullptr;
+    }
+}
+
+gboolean FdRegistry::source_dispatch(GSource *source, GSourceFunc callback, gpointer user_data) {
+    (void)callback;
+    (void)user_data;
+    reinterpret_cast<RegistrySource *>(source)->registry->dispatch();
+    return G_SOURCE_CONTINUE;
+}
+
+} // namespace waybar::cffi::common
@@ -0,0 +1,392 @@
+// 无界面宿主：像waybar一样加载模块库（libcpu.so等），按固定频率驱动更新，
+// 以JSON行输出每次更新的采样和渲染耗时、标签和tooltip，
+// 最后输出耗时分位数和内存占用，用于性能测量和回归测试
+// 例如: wbcffi-host ./libcpu.so --config '{"interval": 0.5, "format": "{usage}%"}' --ticks 20 --rate 2
+// 每次更新先通过wbcffi_host_tick立即采集，再调用wbcffi_update渲染，两步分别计时；
+// 模块自己的定时器仍按interval在两次更新之间运行；--rate 0时不等待，
+// 配合trace-replay全速回放采样轨迹
+#include <module_base.hpp>
+#include <dlfcn.h>
+#include <fmt/format.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using json = nlohmann::json;
+
+struct Options {
+    std::string library;
+    json config = json::object();
+    size_t ticks = 10;
+    double rate = 1.0; // 每秒调用wbcffi_update的次数，0表示全速
+};
+
+// 模块库导出的函数
+struct ModuleApi {
+    void *handle = nullptr;
+    const size_t *version = nullptr;
+    decltype(&wbcffi_init) init = nullptr;
+    decltype(&wbcffi_deinit) deinit = nullptr;
+    decltype(&wbcffi_update) update = nullptr;
+    decltype(&wbcffi_get_widget) get_widget = nullptr;
+    decltype(&wbcffi_host_tooltip) host_tooltip = nullptr;
+    decltype(&wbcffi_host_tick) host_tick = nullptr;
+};
+
+// 宿主状态，通过wbcffi_module指针交给模块
+struct Host {
+    GtkWidget *window = nullptr;
+    GtkWidget *root = nullptr;
+    ModuleApi api;
+    void *instance = nullptr;
+    std::atomic<uint64_t> queued_updates{0};
+};
+
+void usage(const char *argv0) {
+    std::fprintf(
+        stderr,
+        "Usage: %s MODULE.so [--config JSON | --config-file PATH] [--ticks N] [--rate HZ]\n"
+        "  --config JSON       module configuration object, same keys as in the waybar config\n"
+        "  --config-file PATH  read the configuration object from a file\n"
+        "  --ticks N           number of wbcffi_update calls (default 10)\n"
+        "  --rate HZ           ticks per second (default 1); 0 runs ticks back to back,\n"
+        "                      e.g. to replay a trace at full speed\n"
+        "Each tick samples through wbcffi_host_tick and renders through wbcffi_update, timed separately\n"
+        "(sample_us, render_us). The module's own interval timer keeps running between ticks; with\n"
+        "sampling-thread the sample is only requested and rendered by a later tick.\n"
+        "Exits with status 77 when GTK cannot be initialized (no display).\n",
+        argv0
+    );
+}
+
+bool parse_options(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&]() -> const char * { return i + 1 < argc ? argv[++i] : nullptr; };
+        try {
+            if (arg == "--config") {
+                const char *value = next();
+                if (!value) {
+                    return false;
+                }
+                options.config = json::parse(value);
+            } else if (arg == "--config-file") {
+                const char *value = next();
+                if (!value) {
+                    return false;
+                }
+                std::ifstream file(value);
+                if (!file) {
+                    std::fprintf(stderr, "Failed to open %s\n", value);
+                    return false;
+                }
+                options.config = json::parse(file);
+            } else if (arg == "--ticks") {
+                const char *value = next();
+                if (!value) {
+                    return false;
+                }
+                options.ticks = std::stoul(value);
+            } else if (arg == "--rate") {
+                const char *value = next();
+                if (!value) {
+                    return false;
+                }
+                options.rate = std::stod(value);
+            } else if (!arg.empty() && arg[0] != '-' && options.library.empty()) {
+                options.library = arg;
+            } else {
+                return false;
+            }
+        } catch (const std::exception &e) {
+            std::fprintf(stderr, "Invalid value for %s: %s\n", arg.c_str(), e.what());
+            return false;
+        }
+    }
+
+    if (!options.config.is_object()) {
+        std::fprintf(stderr, "Configuration must be a JSON object\n");
+        return false;
+    }
+    if (!(options.rate >= 0.0)) {
+        std::fprintf(stderr, "Rate must not be negative\n");
+        return false;
+    }
+    return !options.library.empty();
+}
+
+bool load_module(const std::string &path, ModuleApi &api) {
+    // 模块依赖的fmt符号由宿主进程提供（与waybar相同），
+    // RTLD_LOCAL保证多个模块库的公共代码互不干扰
+    api.handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!api.handle) {
+        std::fprintf(stderr, "Failed to load %s: %s\n", path.c_str(), dlerror());
+        return false;
+    }
+
+    api.version = reinterpret_cast<const size_t *>(dlsym(api.handle, "wbcffi_version"));
+    api.init = reinterpret_cast<decltype(api.init)>(dlsym(api.handle, "wbcffi_init"));
+    api.deinit = reinterpret_cast<decltype(api.deinit)>(dlsym(api.handle, "wbcffi_deinit"));
+    api.update = reinterpret_cast<decltype(api.update)>(dlsym(api.handle, "wbcffi_update"));
+    api.get_widget = reinterpret_cast<decltype(api.get_widget)>(dlsym(api.handle, "wbcffi_get_widget"));
+    api.host_tooltip = reinterpret_cast<decltype(api.host_tooltip)>(dlsym(api.handle, "wbcffi_host_tooltip"));
+    api.host_tick = reinterpret_cast<decltype(api.host_tick)>(dlsym(api.handle, "wbcffi_host_tick"));
+
+    if (!api.version || !api.init || !api.deinit) {
+        std::fprintf(stderr, "%s does not export the wbcffi interface\n", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+// wbcffi_init_info回调
+GtkContainer *get_root_widget(wbcffi_module *obj) {
+    return GTK_CONTAINER(reinterpret_cast<Host *>(obj)->root);
+}
+
+// 与waybar相同：queue_update可能在采样线程中调用，更新在主线程的下一次迭代中执行
+void queue_update(wbcffi_module *obj) {
+    auto *host = reinterpret_cast<Host *>(obj);
+    host->queued_updates.fetch_add(1, std::memory_order_relaxed);
+    g_idle_add(
+        [](gpointer user_data) -> gboolean {
+            auto *host = static_cast<Host *>(user_data);
+            if (host->instance && host->api.update) {
+                host->api.update(host->instance);
+            }
+            return G_SOURCE_REMOVE;
+        },
+        host
+    );
+}
+
+// waybar把配置值序列化为JSON文本传给模块（字符串带引号），这里保持一致
+std::vector<std::string> serialize_config(const json &config, std::vector<wbcffi_config_entry> &entries) {
+    std::vector<std::string> storage;
+    storage.reserve(config.size() * 2);
+    for (auto it = config.begin(); it != config.end(); ++it) {
+        storage.push_back(it.key());
+        storage.push_back(it.value().dump());
+    }
+    for (size_t i = 0; i < storage.size(); i += 2) {
+        entries.push_back(wbcffi_config_entry{storage[i].c_str(), storage[i + 1].c_str()});
+    }
+    return storage;
+}
+
+// 在模块的组件树中查找标签
+GtkLabel *find_label(GtkWidget *widget) {
+    if (!widget) {
+        return nullptr;
+    }
+    if (GTK_IS_LABEL(widget)) {
+        return GTK_LABEL(widget);
+    }
+    if (GTK_IS_BIN(widget)) {
+        return find_label(gtk_bin_get_child(GTK_BIN(widget)));
+    }
+    return nullptr;
+}
+
+std::string read_tooltip(const Host &host) {
+    if (!host.api.host_tooltip) {
+        return std::string();
+    }
+    std::string text(host.api.host_tooltip(host.instance, nullptr, 0), '\0');
+    if (!text.empty()) {
+        host.api.host_tooltip(host.instance, text.data(), text.size() + 1);
+    }
+    return text;
+}
+
+int64_t clock_us(clockid_t clock) {
+    timespec ts{};
+    clock_gettime(clock, &ts);
+    return int64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+// 读取/proc/self/status中的VmRSS和VmHWM（KiB）
+json memory_usage() {
+    json result = json::object();
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        for (const char *key : {"VmRSS", "VmHWM"}) {
+            size_t key_length = std::strlen(key);
+            if (line.compare(0, key_length, key) == 0 && line.size() > key_length && line[key_length] == ':') {
+                result[std::string(key) == "VmRSS" ? "rss_kb" : "max_rss_kb"] =
+                    std::strtoull(line.c_str() + key_length + 1, nullptr, 10);
+            }
+        }
+    }
+    return result;
+}
+
+// 最近秩法计算的分位数（微秒）
+json percentiles(std::vector<int64_t> values) {
+    json result = json::object();
+    if (values.empty()) {
+        return result;
+    }
+    std::sort(values.begin(), values.end());
+    auto at = [&](double q) {
+        size_t rank = static_cast<size_t>(std::ceil(q * static_cast<double>(values.size())));
+        return values[std::clamp<size_t>(rank, 1, values.size()) - 1];
+    };
+    result["p50"] = at(0.50);
+    result["p90"] = at(0.90);
+    result["p99"] = at(0.99);
+    result["max"] = values.back();
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    // 没有显示时返回77，测试脚本和CTest据此跳过而不是判为失败
+    if (!gtk_init_check(&argc, &argv)) {
+        std::fprintf(stderr, "Failed to initialize GTK (no display available)\n");
+        return 77;
+    }
+
+    Host host;
+    if (!load_module(options.library, host.api)) {
+        return 1;
+    }
+
+    // 离屏窗口：组件会被实现和映射（模块在不可见时暂停采样），但不需要合成器
+    host.window = gtk_offscreen_window_new();
+    host.root = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
+    gtk_container_add(GTK_CONTAINER(host.window), host.root);
+    gtk_widget_show_all(host.window);
+
+    std::vector<wbcffi_config_entry> entries;
+    auto storage = serialize_config(options.config, entries);
+
+    wbcffi_init_info init_info{};
+    init_info.obj = reinterpret_cast<wbcffi_module *>(&host);
+    init_info.waybar_version = "wbcffi-host";
+    init_info.get_root_widget = get_root_widget;
+    init_info.queue_update = queue_update;
+
+    host.instance = host.api.init(&init_info, entries.data(), entries.size());
+    if (!host.instance) {
+        std::fprintf(stderr, "wbcffi_init failed\n");
+        return 1;
+    }
+    gtk_widget_show_all(host.window);
+
+    GtkLabel *label = find_label(host.api.get_widget ? host.api.get_widget(host.instance) : nullptr);
+    bool full_speed = options.rate == 0.0;
+    if (!host.api.host_tick) {
+        std::fprintf(stderr, "%s does not export wbcffi_host_tick\n", options.library.c_str());
+        return 1;
+    }
+    auto period = full_speed ? std::chrono::steady_clock::duration::zero()
+                             : std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                   std::chrono::duration<double>(1.0 / options.rate)
+                               );
+    auto start = std::chrono::steady_clock::now();
+    std::vector<int64_t> sample_us;
+    std::vector<int64_t> render_us;
+    std::vector<int64_t> update_us;
+    std::vector<int64_t> cpu_us;
+
+    for (size_t tick = 0; tick < options.ticks; ++tick) {
+        // 在两次更新之间运行主循环，模块的定时器、fd事件和排队的更新在这里执行
+        auto deadline = start + period * static_cast<int64_t>(tick + 1);
+        int64_t cpu_start = clock_us(CLOCK_PROCESS_CPUTIME_ID);
+        uint64_t queued_before = host.queued_updates.load(std::memory_order_relaxed);
+        while (true) {
+            while (g_main_context_pending(nullptr)) {
+                g_main_context_iteration(nullptr, FALSE);
+            }
+            auto now = std::chrono::steady_clock::now();
+            if (now >= deadline) {
+                break;
+            }
+            // 最多等到下一次更新的时刻，期间有事件就绪时提前醒来
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count();
+            bool woke = false;
+            guint timeout_id = g_timeout_add(
+                static_cast<guint>(std::max<int64_t>(remaining, 1)),
+                [](gpointer user_data) -> gboolean {
+                    *static_cast<bool *>(user_data) = true;
+                    return G_SOURCE_REMOVE;
+                },
+                &woke
+            );
+            g_main_context_iteration(nullptr, TRUE);
+            if (!woke) {
+                g_source_remove(timeout_id);
+            }
+        }
+
+        // wbcffi_update只用缓存的样本重新渲染，采样由wbcffi_host_tick完成
+        int64_t sample_start = clock_us(CLOCK_MONOTONIC);
+        host.api.host_tick(host.instance);
+        int64_t render_start = clock_us(CLOCK_MONOTONIC);
+        if (host.api.update) {
+            host.api.update(host.instance);
+        }
+        int64_t render_end = clock_us(CLOCK_MONOTONIC);
+        int64_t sample_elapsed = render_start - sample_start;
+        int64_t render_elapsed = render_end - render_start;
+        int64_t update_elapsed = render_end - sample_start;
+        int64_t cpu_elapsed = clock_us(CLOCK_PROCESS_CPUTIME_ID) - cpu_start;
+        sample_us.push_back(sample_elapsed);
+        render_us.push_back(render_elapsed);
+        update_us.push_back(update_elapsed);
+        cpu_us.push_back(cpu_elapsed);
+
+        json line = {
+            {"tick", tick},
+            {"time_ms", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()},
+            {"sample_us", sample_elapsed},
+            {"render_us", render_elapsed},
+            {"update_us", update_elapsed},
+            {"cpu_us", cpu_elapsed},
+            {"queued_updates", host.queued_updates.load(std::memory_order_relaxed) - queued_before},
+            {"label", label ? gtk_label_get_text(label) : ""},
+            {"tooltip", read_tooltip(host)},
+        };
+        fmt::print("{}\n", line.dump());
+        std::fflush(stdout);
+    }
+
+    json summary = {
+        {"summary", true},
+        {"library", options.library},
+        {"ticks", options.ticks},
+        {"rate", options.rate},
+        {"sample_us", percentiles(sample_us)},
+        {"render_us", percentiles(render_us)},
+        {"update_us", percentiles(update_us)},
+        {"cpu_us", percentiles(cpu_us)},
+    };
+    summary.update(memory_usage());
+    fmt::print("{}\n", summary.dump());
+
+    host.api.deinit(host.instance);
+    host.instance = nullptr;
+    gtk_widget_destroy(host.window);
+    // 模块可能仍有挂在主循环上的回调引用库代码，不卸载库
+    return 0;
+}
@@ -1,95 +1,45 @@
 #include <modules/cpu_module.hpp>
-#include <fstream>
 #include <common.hpp>
 
 namespace waybar::cffi::cpu {
 
-// CpuModule实现
-CpuModule::CpuModule(
-    const wbcffi_init_info *init_info, const wbcffi_config_entry *config_entries, size_t config_entries_len
-)
-    : base::ModuleBase<CpuConfig>(init_info, config_entries, config_entries_len) {
-    // 初始更新
-    update();
+// CpuSampler实现
+CpuSampler::CpuSampler(common::SampleBatch::Backend backend) : base::SharedSampler<CpuSample>(backend) {
+    // 只需要第一行的cpu汇总数据
+    stat_index_ = sample_batch_.add("/proc/stat", 512);
 }
 
-void CpuModule::update() {
-    // 获取当前CPU时间
-    CpuTimes current_times = get_cpu_times();
+CpuSample CpuSampler::collect() {
+    sample_batch_.submit();
 
-    // 计算CPU使用率
+    // 获取当前CPU时间并计算CPU使用率
+    CpuTimes current_times = get_cpu_times();
     float usage = calculate_cpu_usage(prev_times, current_times);
-
-    // 使用get_state方法设置CSS类并获取状态名称
-    std::string state_name = get_state(usage);
-
-    // 获取对应的图标和格式
-    const std::string &icon = get_icon_for_state_name(state_name);
-    const std::string &format = get_format_for_state_name(state_name);
-
-    // 定义format_args，供format和tooltip共同使用
-    std::vector<std::pair<std::string, waybar::cffi::common::format_arg>> args = {
-        {"icon", icon}, {"usage", common::format_number(usage)}, {"state", state_name}
-    };
-
-    std::string display_text = common::safe_execute<std::string>(
-        [&]() { return common::format_string(format, args); }, format + " " + icon + " " + common::format_number(usage),
-        "Error formatting output"
-    );
-
-    // 更新标签
-    gtk_label_set_text(GTK_LABEL(label_), display_text.c_str());
-
-    // 设置tooltip
-    if (config().tooltip) {
-        auto tooltip_format = get_tooltip_format();
-        std::string tooltip = common::safe_execute<std::string>(
-            [&]() { return common::format_string(tooltip_format, args); }, icon + " " + common::format_number(usage),
-            "Error formatting tooltip"
-        );
-
-        gtk_widget_set_tooltip_text(event_box_, tooltip.c_str());
-    } else {
-        gtk_widget_set_has_tooltip(event_box_, FALSE);
-    }
-
     prev_times = current_times;
+
+    return CpuSample{usage};
 }
 
-CpuModule::CpuTimes CpuModule::get_cpu_times() const {
+CpuSampler::CpuTimes CpuSampler::get_cpu_times() {
     return common::safe_execute<CpuTimes>(
-        []() {
-            std::ifstream file("/proc/stat");
-            if (!file) {
-                throw std::runtime_error("Failed to open /proc/stat");
-            }
-
-            std::string line;
-            if (!std::getline(file, line)) {
-                throw std::runtime_error("Failed to read from /proc/stat");
-            }
+        [&]() {
+            std::string_view content = sample_batch_.text(stat_index_);
+            std::string_view line = content.substr(0, content.find('\n'));
 
             // 解析CPU时间，格式: cpu user nice system idle iowait irq softirq steal guest
             // guest_nice
-            uint64_t user, nice, system, idle, iowait, irq, softirq, steal, guest, guest_nice;
-            if (sscanf(
-                    line.c_str(), "cpu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu", &user, &nice, &system, &idle, &iowait,
-                    &irq, &softirq, &steal, &guest, &guest_nice
-                ) != 10) {
+            common::CpuStatTimes times;
+            if (!common::parse_cpu_stat_line(line, times)) {
                 throw std::runtime_error("Failed to parse /proc/stat");
             }
 
-            // 计算总时间和空闲时间
-            uint64_t idle_time = idle + iowait;
-            uint64_t total_time = user + nice + system + idle + iowait + irq + softirq + steal + guest + guest_nice;
-
-            return CpuTimes{idle_time, total_time};
+            return CpuTimes{times.idle, times.total};
         },
         CpuTimes{0, 0}, "Error reading CPU times"
     );
 }
 
-float CpuModule::calculate_cpu_usage(const CpuTimes &prev, const CpuTimes &curr) const {
+float CpuSampler::calculate_cpu_usage(const CpuTimes &prev, const CpuTimes &curr) const {
     if (curr.total <= prev.total) {
         return 0.0f;
     }
@@ -104,6 +54,45 @@ float CpuModule::calculate_cpu_usage(const CpuTimes &prev, const CpuTimes &curr)
     return 100.0f * (1.0f - static_cast<float>(idle_diff) / static_cast<float>(total_diff));
 }
 
+// CpuModule实现
+CpuModule::CpuModule(
+    const wbcffi_init_info *init_info, const wbcffi_config_entry *config_entries, size_t config_entries_len
+)
+    : base::ModuleBase<CpuConfig, CpuSample>(init_info, config_entries, config_entries_len) {
+    // 所有实例共享同一个/proc/stat采样器
+    sampler_ = common::SharedRegistry<CpuSampler>::acquire(sampler_key("/proc/stat"), [&]() {
+        return std::make_shared<CpuSampler>(sample_backend());
+    });
+
+    // 初始更新
+    update();
+}
+
+void CpuModule::render(const CpuSample &sample) {
+    float usage = sample.usage;
+
+    // 使用get_state方法设置CSS类并获取状态
+    common::KeyId state = get_state(usage);
+
+    // 获取对应的图标和格式
+    const std::string &icon = get_icon(state);
+    const common::FormatTemplate &format = get_format(state);
+
+    // 定义format_args，供format和tooltip共同使用（顺序与CpuConfig::format_args一致）
+    std::vector<common::format_arg> args = {icon, common::format_number(usage), key_name(state)};
+
+    std::string display_text = common::safe_execute<std::string>(
+        [&]() { return format.render(args); }, format.source() + " " + icon + " " + common::format_number(usage),
+        "Error formatting output"
+    );
+
+    // 更新标签
+    set_label_text(display_text);
+
+    // 保存tooltip参数，tooltip在显示时才渲染
+    set_tooltip_args(std::move(args));
+}
+
 #define MODULENAME CpuModule
 #include <wbcffi.txt>
 #undef MODULENAME
@@ -1,15 +1,55 @@
 #include <modules/gpu_module.hpp>
-#include <fstream>
 #include <common.hpp>
 #include <filesystem>
 
 namespace waybar::cffi::gpu {
 
+// GpuSampler实现
+GpuSampler::GpuSampler(const GpuConfig &config, common::SampleBatch::Backend backend)
+    : base::SharedSampler<GpuSample>(backend) {
+    gpu_usage_index_ = sample_batch_.add(config.gpu_usage_path);
+    vram_used_index_ = sample_batch_.add(config.vram_used_path);
+}
+
+GpuSample GpuSampler::collect() {
+    // 处于退避期的数据源本次不读取
+    auto now = common::SourceHealth::clock::now();
+    sample_batch_.set_enabled(gpu_usage_index_, gpu_usage_health_.should_attempt(now));
+    sample_batch_.set_enabled(vram_used_index_, vram_used_health_.should_attempt(now));
+    sample_batch_.submit();
+
+    // 获取GPU使用率和VRAM使用量
+    return GpuSample{get_gpu_usage(now), get_vram_used(now)};
+}
+
+int GpuSampler::get_gpu_usage(common::SourceHealth::clock::time_point now) {
+    // GPU下电或设备消失时按退避间隔重试，期间显示0
+    return gpu_usage_health_.attempt<int>(
+        [&]() { return static_cast<int>(sample_batch_.int64(gpu_usage_index_)); }, 0, now
+    );
+}
+
+double GpuSampler::get_vram_used(common::SourceHealth::clock::time_point now) {
+    return vram_used_health_.attempt<double>(
+        [&]() {
+            // VRAM值通常以字节为单位，转换为GB
+            uint64_t vram_bytes = sample_batch_.uint64(vram_used_index_);
+            return double(vram_bytes) / (1024.0 * 1024.0 * 1024.0);
+        },
+        0.0, now
+    );
+}
+
 // GpuModule实现
 GpuModule::GpuModule(
     const wbcffi_init_info *init_info, const wbcffi_config_entry *config_entries, size_t config_entries_len
 )
-    : base::ModuleBase<GpuConfig>(init_info, config_entries, config_entries_len) {
+    : base::ModuleBase<GpuConfig, GpuSample>(init_info, config_entries, config_entries_len) {
+    // 读取同一组sysfs文件的实例共享采样器
+    std::string source = config_->gpu_usage_path + "\n" + config_->vram_used_path;
+    sampler_ = common::SharedRegistry<GpuSampler>::acquire(sampler_key(source), [&]() {
+        return std::make_shared<GpuSampler>(*config_, sample_backend());
+    });
 
     // 标记此模块处理按钮点击事件
     handles_button_press_ = true;
@@ -17,113 +57,51 @@ GpuModule::GpuModule(
     update();
 }
 
-void GpuModule::update() {
+void GpuModule::render(const GpuSample &sample) {
     try {
-        // 获取GPU使用率和VRAM使用量
-        int gpu_usage = get_gpu_usage();
-        double vram_used = get_vram_used();
+        int gpu_usage = sample.gpu_usage;
+        double vram_used = sample.vram_used;
 
         // 确定当前使用的格式
-        const std::string &format_key = current_format_key_.empty() ? "default" : current_format_key_;
-        std::string format_str = get_format_for_state_name(format_key);
+        const common::FormatTemplate &format = get_format(current_format_key_);
 
         // 获取状态对应的图标
-        std::string state_name = get_state(gpu_usage);
-        const std::string &icon = get_icon_for_state_name(state_name);
+        common::KeyId state = get_state(gpu_usage);
+        const std::string &icon = get_icon(state);
 
-        // 使用混合类型的format_string函数，支持格式说明符
-        std::vector<std::pair<std::string, waybar::cffi::common::format_arg>> args = {
-            {"icon", icon}, {"gpu_usage", gpu_usage}, {"vram_used", common::format_number(vram_used)}
-        };
+        // 定义format_args，供format和tooltip共同使用（顺序与GpuConfig::format_args一致）
+        std::vector<common::format_arg> args = {icon, gpu_usage, common::format_number(vram_used), key_name(state)};
 
         std::string text = common::safe_execute<std::string>(
-            [&]() { return common::format_string(format_str, args); }, icon + " " + std::to_string(gpu_usage),
+            [&]() { return format.render(args); }, icon + " " + std::to_string(gpu_usage),
             "Error formatting output"
         );
-        gtk_label_set_text(GTK_LABEL(label_), text.c_str());
-
-        // 设置tooltip
-        if (config().tooltip) {
-            auto tooltip_format = get_tooltip_format();
-            std::string tooltip = common::safe_execute<std::string>(
-                [&]() { return common::format_string(tooltip_format, args); }, icon + " " + std::to_string(gpu_usage),
-                "Error formatting tooltip"
-            );
-            gtk_widget_set_tooltip_text(event_box_, tooltip.c_str());
-        }
+        set_label_text(text);
+
+        // 保存tooltip参数，tooltip在显示时才渲染
+        set_tooltip_args(std::move(args));
 
     } catch (const std::exception &e) {
         common::log_error("Error updating GPU module: {}", e.what());
-        gtk_label_set_text(GTK_LABEL(label_), "Error");
+        set_label_text("Error");
     }
 }
 
-int GpuModule::get_gpu_usage() const {
-    return common::safe_execute<int>(
-        [&]() {
-            std::ifstream file(config().gpu_usage_path);
-            if (!file.is_open()) {
-                throw std::runtime_error("Failed to open GPU usage file: " + config().gpu_usage_path);
-            }
-
-            std::string line;
-            if (!std::getline(file, line)) {
-                throw std::runtime_error("Failed to read GPU usage from: " + config().gpu_usage_path);
-            }
-
-            // 去除空白字符
-            line.erase(0, line.find_first_not_of(" \t\n\r\f\v"));
-            line.erase(line.find_last_not_of(" \t\n\r\f\v") + 1);
-
-            try {
-                return std::stoi(line);
-            } catch (const std::exception &e) {
-                throw std::runtime_error("Failed to parse GPU usage value: " + line);
-            }
-        },
-        0, "Error reading GPU usage"
-    );
-}
-
-double GpuModule::get_vram_used() const {
-    return common::safe_execute<double>(
-        [&]() {
-            std::ifstream file(config().vram_used_path);
-            if (!file.is_open()) {
-                throw std::runtime_error("Failed to open VRAM usage file: " + config().vram_used_path);
-            }
-
-            std::string line;
-            if (!std::getline(file, line)) {
-                throw std::runtime_error("Failed to read VRAM usage from: " + config().vram_used_path);
-            }
-
-            try {
-                // VRAM值通常以字节为单位，转换为GB
-                unsigned long vram_bytes = std::stoul(line);
-                return double(vram_bytes) / (1024.0 * 1024.0 * 1024.0);
-            } catch (const std::exception &e) {
-                throw std::runtime_error("Failed to parse VRAM usage value: " + line);
-            }
-        },
-        0.0, "Error reading VRAM usage"
-    );
-}
-
 gboolean GpuModule::handle_button_press(GdkEventButton *event) {
     // 只处理左键点击事件
     if (event->button == GDK_BUTTON_PRIMARY) {
         // 切换格式键
-        if (current_format_key_ == "default") {
-            current_format_key_ = "alt";
+        if (current_format_key_ == common::KEY_DEFAULT) {
+            current_format_key_ = common::KEY_ALT;
         } else {
-            current_format_key_ = "default";
+            current_format_key_ = common::KEY_DEFAULT;
         }
 
-        // 立即更新显示
-        update();
+        // 用缓存的样本立即重新渲染，
+        // 不重新读取sysfs（读取会唤醒运行时挂起的独立显卡）
+        rerender();
 
-        common::log_info("GPU module format switched to: {}", current_format_key_);
+        common::log_info("GPU module format switched to: {}", key_name(current_format_key_));
 
         // 返回TRUE表示我们已经处理了点击事件
         return TRUE;
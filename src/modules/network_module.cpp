@@ -1,5 +1,4 @@
 #include <modules/network_module.hpp>
-#include <fstream>
 #include <sstream>
 #include <dirent.h>
 #include <sys/socket.h>
@@ -12,8 +11,14 @@
 #include <net/if.h>
 #include <linux/wireless.h>
 #include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <cerrno>
 #include <chrono>
 #include <regex>
+#include <cctype>
+#include <filesystem>
 #include <common.hpp>
 
 namespace waybar::cffi::network {
@@ -27,70 +32,139 @@ void NetworkConfig::parse_config(const wbcffi_config_entry *entries, size_t coun
     interface = common::get_config_value<std::string>(config_map, "interface", interface);
     accumulate_bandwidth = common::get_config_value<bool>(config_map, "accumulate-bandwidth", accumulate_bandwidth);
     max_bandwidth = common::get_config_value<int>(config_map, "max-bandwidth", max_bandwidth);
+
+    // states总是包含默认的wireless-N阈值，只看用户配置里有没有wireless-N键；
+    // 解析错误已由基类报告
+    auto states_value = config_map.find("states");
+    if (states_value != config_map.end()) {
+        try {
+            nlohmann::json user_states = nlohmann::json::parse(states_value->second);
+            for (auto it = user_states.begin(); it != user_states.end(); ++it) {
+                wireless_states = wireless_states || it.key().starts_with("wireless-");
+            }
+        } catch (const nlohmann::json::exception &) {
+        }
+    }
 }
 
-// NetworkModule实现
-NetworkModule::NetworkModule(
-    const wbcffi_init_info *init_info, const wbcffi_config_entry *config_entries, size_t config_entries_len
-)
-    : base::ModuleBase<NetworkConfig>(init_info, config_entries, config_entries_len) {
+// NetworkSampler实现
+NetworkSampler::NetworkSampler(std::string interface, common::SampleBatch::Backend backend)
+    : base::SharedSampler<NetworkSample>(backend), interface_(std::move(interface)),
+      trace_key_("network:interfaces:" + interface_) {
+    // 使用固定数据或回放轨迹时没有内核事件
+    if (!common::data_root().empty() || common::SampleTrace::instance().replaying()) {
+        return;
+    }
 
-    // 初始更新
-    update();
+    // 订阅链路和地址变化，连接状态改变时不必等到下一个周期
+    netlink_fd_ = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (netlink_fd_ < 0) {
+        common::log_warning("Failed to open netlink socket, link changes are only seen by polling");
+        return;
+    }
+
+    struct sockaddr_nl addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+    if (bind(netlink_fd_, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0) {
+        common::log_warning("Failed to bind netlink socket, link changes are only seen by polling");
+        close(netlink_fd_);
+        netlink_fd_ = -1;
+    }
 }
 
-void NetworkModule::update() {
-    // 扫描所有网络接口
-    scan_network_interfaces();
+NetworkSampler::~NetworkSampler() {
+    if (netlink_fd_ >= 0) {
+        close(netlink_fd_);
+    }
+}
 
-    // 选择最佳接口
-    select_best_interface();
+void NetworkSampler::drain_events() {
+    // 消息内容不需要解析，下一次采集会重新扫描所有接口
+    char buffer[8192];
+    bool changed = false;
+    while (true) {
+        ssize_t received = recv(netlink_fd_, buffer, sizeof(buffer), 0);
+        if (received > 0) {
+            changed = true;
+        } else if (received < 0 && errno == ENOBUFS) {
+            // 接收队列溢出，丢失了部分消息，同样需要重新扫描
+            changed = true;
+        } else if (received < 0 && errno == EINTR) {
+            continue;
+        } else {
+            break;
+        }
+    }
 
-    // 如果没有找到接口，显示断开连接状态
-    if (selected_interface_.empty() || interfaces_.find(selected_interface_) == interfaces_.end()) {
-        // 使用断开连接的格式
-        const std::string &icon = get_icon_for_state_name("disconnected");
-        const std::string &format = get_format_for_state_name("disconnected");
+    if (changed) {
+        invalidate();
+    }
+}
 
-        std::string display_text = common::safe_execute<std::string>(
-            [&]() {
-                std::vector<std::pair<std::string, common::format_arg>> args = {{"icon", icon}, {"ifname", "None"}};
-                return common::format_string(format, args);
-            },
-            icon + " None", "Error formatting disconnected output"
-        );
+NetworkSample NetworkSampler::collect() {
+    if (common::SampleTrace::instance().replaying()) {
+        return collect_from(replay_interfaces());
+    }
+    std::map<std::string, NetworkInterface> interfaces = scan_network_interfaces(collectors());
+    record_interfaces(interfaces);
+    return collect_from(std::move(interfaces));
+}
 
-        gtk_label_set_text(GTK_LABEL(label_), display_text.c_str());
+common::Task<NetworkSample> NetworkSampler::sample_async(clock::duration max_age) {
+    // 同一周期内其他实例已经采集过时直接使用缓存
+    if (std::optional<NetworkSample> cached = cached_sample(max_age)) {
+        co_return *cached;
+    }
 
-        // 设置tooltip
-        if (config().tooltip) {
-            gtk_widget_set_tooltip_text(event_box_, "No network interface available");
-        } else {
-            gtk_widget_set_has_tooltip(event_box_, FALSE);
-        }
+    // 回放轨迹时不访问内核，直接在主线程中采集
+    if (common::SampleTrace::instance().replaying()) {
+        co_return sample(max_age);
+    }
 
-        return;
+    // getifaddrs和每个无线接口的ioctl可能阻塞，与计数器读取一起在后台线程中一次完成
+    // 扫描不持有锁，不阻塞其他实例；流量计数器的读取和速率计算需要采样器的状态，
+    // 持有锁完成
+    uint32_t collectors = this->collectors();
+    co_return co_await common::offload([this, collectors, max_age]() {
+        std::map<std::string, NetworkInterface> interfaces = scan_network_interfaces(collectors);
+        record_interfaces(interfaces);
+        return sample_with(max_age, [&]() { return collect_from(std::move(interfaces)); });
+    });
+}
+
+NetworkSample NetworkSampler::collect_from(std::map<std::string, NetworkInterface> interfaces) {
+    interfaces_ = std::move(interfaces);
+    read_interface_stats();
+
+    // 选择最佳接口
+    select_best_interface();
+
+    NetworkSample result{};
+    auto selected = interfaces_.find(selected_interface_);
+    if (selected_interface_.empty() || selected == interfaces_.end()) {
+        return result;
     }
 
     // 获取选定的接口信息
-    const NetworkInterface &iface = interfaces_.at(selected_interface_);
-
-    // 临时计算速率
-    uint64_t rx_rate = 0;
-    uint64_t tx_rate = 0;
+    const NetworkInterface &iface = selected->second;
+    result.connected = true;
+    result.iface = iface;
 
-    // 获取当前时间
-    auto now = std::chrono::steady_clock::now();
-    uint64_t current_time = uint64_t(std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch()).count());
+    // 计数器的读取时间（毫秒，回放轨迹时为记录的时间），刷新间隔可以小于1秒
+    auto now = sample_batch_.sampled_at();
+    uint64_t current_time =
+        uint64_t(std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count());
 
-    // 如果不是第一次更新，计算速率
+    // 如果不是第一次更新，计算每秒速率
     if (last_update_time_ > 0 && current_time > last_update_time_) {
         uint64_t time_diff = current_time - last_update_time_;
         if (time_diff > 0) {
             uint64_t rx_diff = iface.rx_bytes - last_rx_bytes_;
             uint64_t tx_diff = iface.tx_bytes - last_tx_bytes_;
-            rx_rate = rx_diff / time_diff;
-            tx_rate = tx_diff / time_diff;
+            result.rx_rate = rx_diff * 1000 / time_diff;
+            result.tx_rate = tx_diff * 1000 / time_diff;
         }
     }
 
@@ -99,74 +173,21 @@ void NetworkModule::update() {
     last_tx_bytes_ = iface.tx_bytes;
     last_update_time_ = current_time;
 
-    // 根据接口状态确定状态名称、图标和显示格式
-    std::string state_name;
-    std::string icon;
-    std::string format;
-
-    if (!iface.is_up || iface.ip.empty()) {
-        state_name = "disconnected";
-        icon = get_icon_for_state_name("disconnected");
-        format = get_format_for_state_name("disconnected");
-    } else if (iface.is_wireless) {
-        state_name = get_state(iface.quality_link, true);
-        icon = get_icon_for_state_name(state_name);
-        format = get_format_for_state_name("wireless");
-    } else {
-        // 有线连接
-        state_name = "wired";
-        icon = get_icon_for_state_name("wired");
-        format = get_format_for_state_name("wired");
-    }
-
-    // 准备格式化参数
-    std::vector<std::pair<std::string, common::format_arg>> format_args = {
-        {"icon", icon},
-        {"ifname", iface.name},
-        {"ipaddr", iface.ip},
-        {"ipv6", iface.ipv6},
-        {"essid", iface.ssid},
-        {"quality_level", iface.quality_level},
-        {"quality_link", iface.quality_link},
-        {"quality_noise", iface.quality_noise},
-        {"bandwidthRxTot", pow_format5w(iface.rx_bytes)},
-        {"bandwidthTxTot", pow_format5w(iface.tx_bytes)},
-        {"bandwidthRx", pow_format5w(rx_rate)},
-        {"bandwidthTx", pow_format5w(tx_rate)},
-        {"netcidr", iface.ip.empty() ? "" : iface.ip + "/24"}, // 简化实现
-        {"netspeed", pow_format5w(rx_rate + tx_rate)}
-    };
-
-    // 使用公共工具格式化输出
-    std::string display_text = common::safe_execute<std::string>(
-        [&]() { return common::format_string(format, format_args); }, icon + " " + iface.name, "Error formatting output"
-    );
-
-    // 更新标签
-    gtk_label_set_text(GTK_LABEL(label_), display_text.c_str());
-
-    // 设置tooltip
-    if (config().tooltip) {
-        auto tooltip_format = get_tooltip_format();
-        std::string tooltip = common::safe_execute<std::string>(
-            [&]() { return common::format_string(tooltip_format, format_args); }, "Network: " + iface.name,
-            "Error formatting tooltip"
-        );
+    return result;
+}
 
-        gtk_widget_set_tooltip_text(event_box_, tooltip.c_str());
-    } else {
-        gtk_widget_set_has_tooltip(event_box_, FALSE);
+std::map<std::string, NetworkInterface> NetworkSampler::scan_network_interfaces(uint32_t collectors) {
+    if (!common::data_root().empty()) {
+        return scan_fixture_interfaces(collectors);
     }
-}
 
-void NetworkModule::scan_network_interfaces() {
-    interfaces_.clear();
+    std::map<std::string, NetworkInterface> interfaces;
 
     // 使用ifaddrs获取网络接口列表
     struct ifaddrs *ifaddrs_ptr;
     if (getifaddrs(&ifaddrs_ptr) == -1) {
         common::log_error("Failed to get network interfaces");
-        return;
+        return interfaces;
     }
 
     // 遍历所有接口
@@ -183,15 +204,17 @@ void NetworkModule::scan_network_interfaces() {
         }
 
         // 如果接口不存在，创建它
-        if (interfaces_.find(ifname) == interfaces_.end()) {
+        if (interfaces.find(ifname) == interfaces.end()) {
             NetworkInterface iface;
             iface.name = ifname;
             iface.is_up = (ifa->ifa_flags & IFF_UP) != 0;
             iface.is_wireless = false; // 默认为有线，后面会检查
             iface.quality_level = 0;
+            iface.quality_link = 0;
+            iface.quality_noise = 0;
             iface.rx_bytes = 0;
             iface.tx_bytes = 0;
-            interfaces_[ifname] = iface;
+            interfaces[ifname] = iface;
         }
 
         // 获取IP地址
@@ -200,15 +223,15 @@ void NetworkModule::scan_network_interfaces() {
                 struct sockaddr_in *addr_in = (struct sockaddr_in *)ifa->ifa_addr;
                 char addr_str[INET_ADDRSTRLEN];
                 if (inet_ntop(AF_INET, &(addr_in->sin_addr), addr_str, INET_ADDRSTRLEN) != nullptr) {
-                    interfaces_[ifname].ip = addr_str;
+                    interfaces[ifname].ip = addr_str;
                 }
-            } else if (ifa->ifa_addr->sa_family == AF_INET6) {
+            } else if (ifa->ifa_addr->sa_family == AF_INET6 && (collectors & COLLECT_IPV6)) {
                 struct sockaddr_in6 *addr_in6 = (struct sockaddr_in6 *)ifa->ifa_addr;
                 char addr_str[INET6_ADDRSTRLEN];
                 if (inet_ntop(AF_INET6, &(addr_in6->sin6_addr), addr_str, INET6_ADDRSTRLEN) != nullptr) {
                     // 跳过本地链路地址
                     if (std::string(addr_str).find("fe80") != 0) {
-                        interfaces_[ifname].ipv6 = addr_str;
+                        interfaces[ifname].ipv6 = addr_str;
                     }
                 }
             }
@@ -218,7 +241,7 @@ void NetworkModule::scan_network_interfaces() {
     freeifaddrs(ifaddrs_ptr);
 
     // 检查哪些接口是无线接口并获取WiFi信息
-    for (auto &pair : interfaces_) {
+    for (auto &pair : interfaces) {
         std::string ifname = pair.first;
         NetworkInterface &iface = pair.second;
 
@@ -229,30 +252,202 @@ void NetworkModule::scan_network_interfaces() {
         }
 
         // 使用新的函数来确定接口类型
-        determine_interface_type(iface);
-        if (!iface.is_up) {
+        determine_interface_type(iface, collectors);
+    }
+
+    return interfaces;
+}
+
+std::map<std::string, NetworkInterface> NetworkSampler::scan_fixture_interfaces(uint32_t collectors) {
+    std::map<std::string, NetworkInterface> interfaces;
+
+    // 读取整个文件，不存在时返回空字符串
+    auto read_text = [](const std::string &path) -> std::string {
+        try {
+            char buf[256];
+            size_t length = common::SysfsReader(path).read(buf, sizeof(buf));
+            std::string text(buf, length);
+            while (!text.empty() && std::isspace(static_cast<unsigned char>(text.back()))) {
+                text.pop_back();
+            }
+            return text;
+        } catch (const std::exception &) {
+            return std::string();
+        }
+    };
+
+    // 与sysfs相同的布局：/sys/class/net/<接口>/{flags,wireless/,statistics/}
+    // IP地址和SSID在sysfs中没有对应的文件，由固定数据额外提供的ipv4、ipv6、ssid文件给出
+    std::error_code ec;
+    for (const auto &entry : std::filesystem::directory_iterator(common::data_path("/sys/class/net"), ec)) {
+        std::string ifname = entry.path().filename().string();
+        std::string dir = "/sys/class/net/" + ifname + "/";
+
+        // flags为十六进制的IFF_*标志（例如0x1003）
+        unsigned long flags = std::strtoul(read_text(dir + "flags").c_str(), nullptr, 16);
+        if (ifname == "lo" || !(flags & IFF_UP)) {
+            continue;
+        }
+
+        NetworkInterface iface{};
+        iface.name = ifname;
+        iface.is_up = true;
+        iface.ip = read_text(dir + "ipv4");
+        if (collectors & COLLECT_IPV6) {
+            iface.ipv6 = read_text(dir + "ipv6");
+        }
+        iface.is_wireless = std::filesystem::exists(entry.path() / "wireless", ec) ||
+                            std::filesystem::exists(entry.path() / "phy80211", ec);
+        if (iface.is_wireless && (collectors & COLLECT_SSID)) {
+            iface.ssid = read_text(dir + "ssid");
+        } else if (!iface.is_wireless && ifname[0] != 'e') {
+            // 与真实扫描一致，既不是无线也不是以太网的接口不参与选择
+            iface.is_up = false;
+        }
+        interfaces[ifname] = iface;
+    }
+
+    // 无线信号统计使用/proc/net/wireless的格式：
+    // " wlan0: 0000   54.  -56.  -256 ..."（状态、链路质量、信号强度、噪声）
+    if (collectors & COLLECT_QUALITY) {
+        char buf[4096];
+        size_t length = 0;
+        try {
+            length = common::SysfsReader("/proc/net/wireless").read(buf, sizeof(buf));
+        } catch (const std::exception &) {
+        }
+        std::istringstream stream(std::string(buf, length));
+        std::string line;
+        while (std::getline(stream, line)) {
+            size_t colon = line.find(':');
+            if (colon == std::string::npos) {
+                continue;
+            }
+            std::string ifname = line.substr(0, colon);
+            ifname.erase(0, ifname.find_first_not_of(' '));
+            auto it = interfaces.find(ifname);
+            if (it == interfaces.end() || !it->second.is_wireless) {
+                continue;
+            }
+
+            std::istringstream fields(line.substr(colon + 1));
+            std::string status;
+            double link = 0.0;
+            double level = 0.0;
+            double noise = 0.0;
+            if (fields >> status >> link >> level >> noise) {
+                it->second.quality_link = static_cast<int>(link);
+                it->second.quality_level = static_cast<int>(level);
+                it->second.quality_noise = static_cast<int>(noise);
+            }
+        }
+    }
+
+    return interfaces;
+}
+
+void NetworkSampler::record_interfaces(const std::map<std::string, NetworkInterface> &interfaces) const {
+    common::SampleTrace &trace = common::SampleTrace::instance();
+    if (!trace.recording()) {
+        return;
+    }
+
+    // 接口列表来自getifaddrs和ioctl，没有可以原样记录的文件内容，
+    // 因此按sysfs文件的习惯写成一段文本，
+    // 作为trace_key_的一次读取记录：轨迹格式不需要为它增加记录类型，
+    // 也可以直接用文本工具查看
+    // 每个接口一行，字段以制表符分隔；SSID中的制表符和换行替换为空格
+    std::string text;
+    for (const auto &[ifname, iface] : interfaces) {
+        std::string ssid = iface.ssid;
+        std::replace_if(ssid.begin(), ssid.end(), [](char c) { return c == '\t' || c == '\n'; }, ' ');
+        text += fmt::format(
+            "{}\t{:d}\t{:d}\t{}\t{}\t{}\t{}\t{}\t{}\n", ifname, iface.is_up, iface.is_wireless, iface.ip, iface.ipv6,
+            ssid, iface.quality_link, iface.quality_level, iface.quality_noise
+        );
+    }
+    trace.record(trace_key_, common::SampleTrace::clock::now(), text.data(), text.size());
+}
+
+std::map<std::string, NetworkInterface> NetworkSampler::replay_interfaces() {
+    std::map<std::string, NetworkInterface> interfaces;
+    common::SampleTrace::Record record;
+    if (!common::SampleTrace::instance().replay(trace_key_, trace_cursor_, record)) {
+        return interfaces;
+    }
+
+    std::istringstream lines{std::string(record.data)};
+    std::string line;
+    while (std::getline(lines, line)) {
+        std::vector<std::string> fields;
+        std::istringstream stream(line);
+        std::string field;
+        while (std::getline(stream, field, '\t')) {
+            fields.push_back(field);
+        }
+        if (fields.size() < 9) {
             continue;
         }
 
-        // 获取网络统计信息 - 使用lambda表达式
-        auto get_interface_stat = [](const std::string &interface, const std::string &stat) -> uint64_t {
-            std::string path = "/sys/class/net/" + interface + "/statistics/" + stat;
-            std::ifstream file(path);
-            if (!file.is_open()) {
-                return 0;
+        NetworkInterface iface{};
+        iface.name = fields[0];
+        iface.is_up = fields[1] == "1";
+        iface.is_wireless = fields[2] == "1";
+        iface.ip = fields[3];
+        iface.ipv6 = fields[4];
+        iface.ssid = fields[5];
+        iface.quality_link = std::atoi(fields[6].c_str());
+        iface.quality_level = std::atoi(fields[7].c_str());
+        iface.quality_noise = std::atoi(fields[8].c_str());
+        interfaces[iface.name] = iface;
+    }
+    return interfaces;
+}
+
+void NetworkSampler::read_interface_stats() {
+    // 接口集合变化时重建采样批次，其余时候每个接口的计数器文件保持打开
+    bool interfaces_changed = false;
+    size_t up_count = 0;
+    for (const auto &[ifname, iface] : interfaces_) {
+        if (iface.is_up && !ifname.empty()) {
+            ++up_count;
+            interfaces_changed = interfaces_changed || stat_indices_.count(ifname) == 0;
+        }
+    }
+    if (interfaces_changed || up_count != stat_indices_.size()) {
+        sample_batch_.clear();
+        stat_indices_.clear();
+        for (const auto &[ifname, iface] : interfaces_) {
+            if (iface.is_up && !ifname.empty()) {
+                std::string statistics_dir = "/sys/class/net/" + ifname + "/statistics/";
+                size_t rx_index = sample_batch_.add(statistics_dir + "rx_bytes");
+                size_t tx_index = sample_batch_.add(statistics_dir + "tx_bytes");
+                stat_indices_[ifname] = {rx_index, tx_index};
             }
+        }
+    }
 
-            uint64_t value;
-            file >> value;
-            return value;
-        };
+    // 一次读取所有接口的流量计数器
+    sample_batch_.submit();
 
-        iface.rx_bytes = get_interface_stat(ifname, "rx_bytes");
-        iface.tx_bytes = get_interface_stat(ifname, "tx_bytes");
+    auto read_stat = [&](size_t index) -> uint64_t {
+        try {
+            return sample_batch_.uint64(index);
+        } catch (const std::exception &) {
+            return 0;
+        }
+    };
+
+    for (auto &[ifname, iface] : interfaces_) {
+        auto indices = stat_indices_.find(ifname);
+        if (indices != stat_indices_.end()) {
+            iface.rx_bytes = read_stat(indices->second.rx_bytes);
+            iface.tx_bytes = read_stat(indices->second.tx_bytes);
+        }
     }
 }
 
-std::string NetworkModule::get_ip_address(const std::string &interface, bool ipv6) {
+std::string NetworkSampler::get_ip_address(const std::string &interface, bool ipv6) {
     struct ifaddrs *ifaddrs_ptr;
     if (getifaddrs(&ifaddrs_ptr) == -1) {
         return "";
@@ -291,7 +486,7 @@ std::string NetworkModule::get_ip_address(const std::string &interface, bool ipv
     return result;
 }
 
-std::string NetworkModule::get_wifi_ssid(const std::string &interface) {
+std::string NetworkSampler::get_wifi_ssid(const std::string &interface) {
     // 使用ioctl获取SSID，避免依赖外部命令
     int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
     if (sockfd < 0) {
@@ -323,7 +518,7 @@ std::string NetworkModule::get_wifi_ssid(const std::string &interface) {
     return std::string(essid);
 }
 
-void NetworkModule::get_wifi_info(NetworkInterface &iface) {
+void NetworkSampler::get_wifi_info(NetworkInterface &iface) {
     // 初始化为0
     iface.quality_level = 0;
     iface.quality_link = 0;
@@ -383,14 +578,14 @@ void NetworkModule::get_wifi_info(NetworkInterface &iface) {
     }
 }
 
-void NetworkModule::select_best_interface() {
+void NetworkSampler::select_best_interface() {
     // 如果用户指定了接口，尝试使用它
-    if (!config().interface.empty()) {
-        if (interfaces_.find(config().interface) != interfaces_.end()) {
-            selected_interface_ = config().interface;
+    if (!interface_.empty()) {
+        if (interfaces_.find(interface_) != interfaces_.end()) {
+            selected_interface_ = interface_;
             return;
         }
-        common::log_warning("Configured interface '{}' not found, auto-selecting", config().interface);
+        common::log_warning("Configured interface '{}' not found, auto-selecting", interface_);
     }
 
     // 否则，自动选择最佳接口
@@ -431,7 +626,7 @@ void NetworkModule::select_best_interface() {
     }
 }
 
-bool NetworkModule::is_wireless_interface(const std::string &ifname) {
+bool NetworkSampler::is_wireless_interface(const std::string &ifname) {
     // 使用ioctl更准确地判断是否为无线接口，而不是仅依赖名称前缀
     int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
     if (sockfd < 0) {
@@ -449,7 +644,7 @@ bool NetworkModule::is_wireless_interface(const std::string &ifname) {
     return is_wireless;
 }
 
-void NetworkModule::determine_interface_type(NetworkInterface &iface) {
+void NetworkSampler::determine_interface_type(NetworkInterface &iface, uint32_t collectors) {
     if (iface.name.empty()) {
         iface.is_wireless = false;
         return;
@@ -458,8 +653,16 @@ void NetworkModule::determine_interface_type(NetworkInterface &iface) {
     if (is_wireless_interface(iface.name)) {
         // 无线接口
         iface.is_wireless = true;
-        iface.ssid = get_wifi_ssid(iface.name);
-        get_wifi_info(iface);
+        if (collectors & COLLECT_SSID) {
+            iface.ssid = get_wifi_ssid(iface.name);
+        }
+        if (collectors & COLLECT_QUALITY) {
+            get_wifi_info(iface);
+        } else {
+            iface.quality_level = 0;
+            iface.quality_link = 0;
+            iface.quality_noise = 0;
+        }
     } else {
         // 检查是否为以太网接口（以'e'开头）
         char first_char = iface.name[0];
@@ -473,33 +676,137 @@ void NetworkModule::determine_interface_type(NetworkInterface &iface) {
     }
 }
 
-// 参考原始Waybar的pow_format5w实现 - 5字符宽度的格式化
-std::string NetworkModule::pow_format5w(uint64_t bytes) const {
-    const char *units = "KMGTPE";
-    int unit_idx = -1;
-    auto size = static_cast<double>(bytes);
-    auto base = 1000.0; // 使用1000作为基数，与原始实现一致
+// NetworkModule实现
+NetworkModule::NetworkModule(
+    const wbcffi_init_info *init_info, const wbcffi_config_entry *config_entries, size_t config_entries_len
+)
+    : base::ModuleBase<NetworkConfig, NetworkSample>(init_info, config_entries, config_entries_len) {
+
+    // 监控同一接口配置的实例共享采样器，接口扫描和速率计算只进行一次
+    sampler_ = common::SharedRegistry<NetworkSampler>::acquire(sampler_key(config_->interface), [&]() {
+        return std::make_shared<NetworkSampler>(config_->interface, sample_backend());
+    });
 
-    if (size < 10.0) {
-        return "0.00K";
+    // 只采集格式引用的数据；用户配置了wireless-N状态时还需要信号统计来选择CSS类
+    uint32_t collectors = config_->required_collectors;
+    if (config_->wireless_states) {
+        collectors |= COLLECT_QUALITY;
+    }
+    uses_quality_ = (collectors & COLLECT_QUALITY) != 0;
+    sampler_->require(collectors);
+
+    // 接口扫描可能阻塞，主线程模式下通过协程在后台线程中完成
+    async_sampling_ = true;
+
+    // 链路和地址变化由内核推送，收到后立即刷新，定时器只负责速率等需要轮询的数据
+    // 多个实例监听同一个套接字，先被调用的实例读走消息，
+    // 其余实例直接使用它重新采集的样本
+    int event_fd = static_cast<NetworkSampler &>(*sampler_).event_fd();
+    if (event_fd >= 0) {
+        watch_fd(event_fd, EPOLLIN, [this](uint32_t events) {
+            (void)events;
+            static_cast<NetworkSampler &>(*sampler_).drain_events();
+            // 隐藏期间只读走消息，重新可见时会补采一次
+            if (!suspended_) {
+                tick();
+            }
+        });
     }
 
-    while (size >= base && unit_idx < 5) {
-        size /= base;
-        unit_idx++;
+    // 初始更新
+    update();
+}
+
+common::Task<NetworkSample> NetworkModule::sample_async() {
+    co_return co_await static_cast<NetworkSampler &>(*sampler_).sample_async(sample_max_age());
+}
+
+void NetworkModule::render(const NetworkSample &sample) {
+    // 如果没有找到接口，显示断开连接状态
+    if (!sample.connected) {
+        // 使用断开连接的格式
+        const std::string &icon = get_icon(common::KEY_DISCONNECTED);
+        const common::FormatTemplate &format = get_format(common::KEY_DISCONNECTED);
+
+        std::string display_text = common::safe_execute<std::string>(
+            [&]() {
+                // 未使用的参数保持为空，顺序与NetworkConfig::format_args一致
+                std::vector<common::format_arg> args(config().format_args.size(), std::string());
+                args[0] = icon;
+                args[1] = std::string("None");
+                return format.render(args);
+            },
+            icon + " None", "Error formatting disconnected output"
+        );
+
+        set_label_text(display_text);
+
+        // tooltip在显示时由render_tooltip()给出断开提示
+        connected_ = false;
+        set_tooltip_args({});
+
+        return;
     }
 
-    if (unit_idx < 0) {
-        unit_idx = 0;
-        size /= base;
+    const NetworkInterface &iface = sample.iface;
+    uint64_t rx_rate = sample.rx_rate;
+    uint64_t tx_rate = sample.tx_rate;
+
+    // 根据接口状态确定图标和显示格式对应的状态
+    common::KeyId icon_state = common::KEY_DISCONNECTED;
+    common::KeyId format_state = common::KEY_DISCONNECTED;
+
+    if (!iface.is_up || iface.ip.empty()) {
+        // 保持断开连接状态
+    } else if (iface.is_wireless) {
+        // 没有采集信号统计时不按信号选择图标和wireless-N类，质量总是0会误报为最差
+        icon_state = uses_quality_ ? get_state(iface.quality_link, true) : common::KeyId(common::KEY_WIRELESS);
+        format_state = common::KEY_WIRELESS;
+    } else {
+        // 有线连接
+        icon_state = common::KEY_WIRED;
+        format_state = common::KEY_WIRED;
     }
 
-    // 使用common命名空间的format_number函数格式化数值部分，固定4字符宽度
-    std::string number_part = common::format_number(size, 4);
-    std::string unit_part = std::string(1, units[unit_idx]);
-    std::string formatted = number_part + unit_part;
+    const std::string &icon = get_icon(icon_state);
+    const common::FormatTemplate &format = get_format(format_state);
+
+    // 准备格式化参数（顺序与NetworkConfig::format_args一致）
+    std::vector<common::format_arg> format_args = {
+        icon,
+        iface.name,
+        iface.ip,
+        iface.ipv6,
+        iface.ssid,
+        iface.quality_level,
+        iface.quality_link,
+        iface.quality_noise,
+        common::pow_format5w(iface.rx_bytes),
+        common::pow_format5w(iface.tx_bytes),
+        common::pow_format5w(rx_rate),
+        common::pow_format5w(tx_rate),
+        iface.ip.empty() ? "" : iface.ip + "/24", // 简化实现
+        common::pow_format5w(rx_rate + tx_rate)
+    };
 
-    return formatted;
+    // 使用预编译模板格式化输出
+    std::string display_text = common::safe_execute<std::string>(
+        [&]() { return format.render(format_args); }, icon + " " + iface.name, "Error formatting output"
+    );
+
+    // 更新标签
+    set_label_text(display_text);
+
+    // 保存tooltip参数，tooltip在显示时才渲染
+    connected_ = true;
+    set_tooltip_args(std::move(format_args));
+}
+
+std::string NetworkModule::render_tooltip() const {
+    if (!connected_) {
+        return "No network interface available";
+    }
+    return base::ModuleBase<NetworkConfig, NetworkSample>::render_tooltip();
 }
 
 #define MODULENAME NetworkModule
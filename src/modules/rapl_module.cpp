@@ -1,142 +1,156 @@
 #include <modules/rapl_module.hpp>
-#include <fstream>
 #include <common.hpp>
 
 namespace waybar::cffi::rapl {
 
-// RaplModule实现
-RaplModule::RaplModule(
-    const wbcffi_init_info *init_info, const wbcffi_config_entry *config_entries, size_t config_entries_len
-)
-    : base::ModuleBase<RaplConfig>(init_info, config_entries, config_entries_len) {
-    // 内联路径获取函数
-    auto package_path = config().sysfs_dir + "/energy_uj";
-    auto core_path = config().sysfs_dir + ":0/energy_uj";
-    auto package_max_energy_range_path = config().sysfs_dir + "/max_energy_range_uj";
-    auto core_max_energy_range_path = config().sysfs_dir + ":0/max_energy_range_uj";
-
-    // 检查RAPL文件是否存在
-    if (!std::filesystem::exists(package_path) || !std::filesystem::exists(core_path) ||
-        !std::filesystem::exists(package_max_energy_range_path) ||
-        !std::filesystem::exists(core_max_energy_range_path)) {
+// RaplSampler实现
+RaplSampler::RaplSampler(const std::string &sysfs_dir, common::SampleBatch::Backend backend)
+    : base::SharedSampler<RaplSample>(backend) {
+    // 能量计数器路径只在初始化时构造一次
+    auto package_path = sysfs_dir + "/energy_uj";
+    auto core_path = sysfs_dir + ":0/energy_uj";
+    auto package_max_energy_range_path = sysfs_dir + "/max_energy_range_uj";
+    auto core_max_energy_range_path = sysfs_dir + ":0/max_energy_range_uj";
+
+    // 检查RAPL文件是否存在（回放轨迹时内容来自轨迹，不检查）
+    auto exists = [](const std::string &path) { return std::filesystem::exists(common::data_path(path)); };
+    if (!common::SampleTrace::instance().replaying() &&
+        (!exists(package_path) || !exists(core_path) || !exists(package_max_energy_range_path) ||
+         !exists(core_max_energy_range_path))) {
         throw std::runtime_error("RAPL sysfs files not found");
     }
 
     // 在初始化时读取并缓存max_energy_range值
-    package_max_energy_range_ = get_energy_uj(package_max_energy_range_path);
-    core_max_energy_range_ = get_energy_uj(core_max_energy_range_path);
+    package_max_energy_range_ = common::SysfsReader(package_max_energy_range_path).read_uint64();
+    core_max_energy_range_ = common::SysfsReader(core_max_energy_range_path).read_uint64();
 
-    // 初始更新
-    update();
+    // 能量计数器加入采样批次，每次更新统一读取
+    package_energy_index_ = sample_batch_.add(package_path);
+    core_energy_index_ = sample_batch_.add(core_path);
 }
 
-void RaplModule::update() {
-    // 获取当前RAPL数据
-    RaplData current_data = get_rapl_data();
+RaplSample RaplSampler::collect() {
+    // 处于退避期时本次不读取
+    auto now = common::SourceHealth::clock::now();
+    bool attempt = rapl_health_.should_attempt(now);
+    // 没有实例引用core_power/other_power时不读取core域
+    bool read_core = (collectors() & COLLECT_CORE) != 0;
+    sample_batch_.set_enabled(package_energy_index_, attempt);
+    sample_batch_.set_enabled(core_energy_index_, attempt && read_core);
+    sample_batch_.submit();
+
+    // 获取当前RAPL数据，读取失败或处于退避期时为空
+    std::optional<RaplData> current_data = get_rapl_data(now, read_core);
 
     // 计算功耗
     double package_power = 0.0;
     double core_power = 0.0;
 
-    if (!first_update_) {
+    if (current_data && !first_update_) {
         // 计算时间差（秒）
-        std::chrono::duration<double> time_diff = current_data.timestamp - prev_data_.timestamp;
+        std::chrono::duration<double> time_diff = current_data->timestamp - prev_data_.timestamp;
         double seconds = time_diff.count();
 
         if (seconds > 0) {
             // 计算能量差（微焦耳）
-            uint64_t package_energy_diff = current_data.package_energy - prev_data_.package_energy;
-            uint64_t core_energy_diff = current_data.core_energy - prev_data_.core_energy;
+            uint64_t package_energy_diff = current_data->package_energy - prev_data_.package_energy;
 
             // 处理计数器回绕 - 使用缓存的max_energy_range值
             if (package_max_energy_range_ > 0 && package_energy_diff > package_max_energy_range_ / 2) {
                 package_energy_diff += package_max_energy_range_;
             }
 
-            if (core_max_energy_range_ > 0 && core_energy_diff > core_max_energy_range_ / 2) {
-                core_energy_diff += core_max_energy_range_;
-            }
-
             // 计算功耗（瓦特 = 焦耳/秒）
             package_power = calculate_power(package_energy_diff, seconds);
-            core_power = calculate_power(core_energy_diff, seconds);
+
+            // core域刚开始读取时还没有基线
+            if (read_core && prev_has_core_) {
+                uint64_t core_energy_diff = current_data->core_energy - prev_data_.core_energy;
+                if (core_max_energy_range_ > 0 && core_energy_diff > core_max_energy_range_ / 2) {
+                    core_energy_diff += core_max_energy_range_;
+                }
+                core_power = calculate_power(core_energy_diff, seconds);
+            }
         }
     }
 
-    // 更新上一次的值
-    prev_data_ = current_data;
-    first_update_ = false;
-
-    // 计算其他功耗（非核心部分）
-    double other_power = package_power - core_power;
-
-    // 使用get_state方法设置CSS类并获取状态名称
-    std::string state_name = get_state(package_power);
+    // 更新上一次的值；数据不可用时丢弃旧值，恢复后重新建立基线
+    if (current_data) {
+        prev_data_ = *current_data;
+        prev_has_core_ = read_core;
+        first_update_ = false;
+    } else {
+        first_update_ = true;
+    }
 
-    // 获取对应的图标和格式
-    const std::string &icon = get_icon_for_state_name(state_name);
-    const std::string &format = get_format_for_state_name(state_name);
-
-    // 定义format_args，供format和tooltip共同使用
-    std::vector<std::pair<std::string, waybar::cffi::common::format_arg>> args = {
-        {"icon", icon},
-        {"power", common::format_number(package_power)},
-        {"package_power", common::format_number(package_power)},
-        {"core_power", common::format_number(core_power)},
-        {"other_power", common::format_number(other_power)}
-    };
+    return RaplSample{package_power, core_power};
+}
 
-    std::string display_text = common::safe_execute<std::string>(
-        [&]() { return common::format_string(format, args); },
-        format + " " + icon + " " + common::format_number(package_power), "Error formatting output"
+std::optional<RaplData> RaplSampler::get_rapl_data(common::SourceHealth::clock::time_point now, bool read_core) {
+    return rapl_health_.attempt<std::optional<RaplData>>(
+        [&]() -> std::optional<RaplData> {
+            // 读取当前能量值
+            uint64_t package_energy = sample_batch_.uint64(package_energy_index_);
+            uint64_t core_energy = read_core ? sample_batch_.uint64(core_energy_index_) : 0;
+
+            // 使用读取时间（回放轨迹时为记录的时间）
+            return RaplData(package_energy, core_energy, sample_batch_.sampled_at());
+        },
+        std::nullopt, now
     );
+}
 
-    // 更新标签
-    gtk_label_set_text(GTK_LABEL(label_), display_text.c_str());
+double RaplSampler::calculate_power(uint64_t energy_diff, double time_diff_seconds) const {
+    // 转换为焦耳，然后除以时间得到瓦特
+    return (double(energy_diff) / 1000000.0) / time_diff_seconds;
+}
 
-    // 设置tooltip
-    if (config().tooltip) {
-        auto tooltip_format = get_tooltip_format();
-        std::string tooltip = common::safe_execute<std::string>(
-            [&]() { return common::format_string(tooltip_format, args); },
-            icon + " " + common::format_number(package_power), "Error formatting tooltip"
-        );
+// RaplModule实现
+RaplModule::RaplModule(
+    const wbcffi_init_info *init_info, const wbcffi_config_entry *config_entries, size_t config_entries_len
+)
+    : base::ModuleBase<RaplConfig, RaplSample>(init_info, config_entries, config_entries_len) {
+    // 读取同一RAPL域的实例共享采样器
+    sampler_ = common::SharedRegistry<RaplSampler>::acquire(sampler_key(config_->sysfs_dir), [&]() {
+        return std::make_shared<RaplSampler>(config_->sysfs_dir, sample_backend());
+    });
+    sampler_->require(config_->required_collectors);
 
-        gtk_widget_set_tooltip_text(event_box_, tooltip.c_str());
-    } else {
-        gtk_widget_set_has_tooltip(event_box_, FALSE);
-    }
+    // 初始更新
+    update();
 }
 
-RaplData RaplModule::get_rapl_data() const {
-    // 内联路径获取函数
-    auto package_path = config().sysfs_dir + "/energy_uj";
-    auto core_path = config().sysfs_dir + ":0/energy_uj";
+void RaplModule::render(const RaplSample &sample) {
+    double package_power = sample.package_power;
+    double core_power = sample.core_power;
 
-    // 读取当前能量值
-    uint64_t package_energy = get_energy_uj(package_path);
-    uint64_t core_energy = get_energy_uj(core_path);
+    // 计算其他功耗（非核心部分）
+    double other_power = package_power - core_power;
 
-    // 获取当前时间
-    auto current_time = std::chrono::steady_clock::now();
+    // 使用get_state方法设置CSS类并获取状态
+    common::KeyId state = get_state(package_power);
 
-    return RaplData(package_energy, core_energy, current_time);
-}
+    // 获取对应的图标和格式
+    const std::string &icon = get_icon(state);
+    const common::FormatTemplate &format = get_format(state);
+
+    // 定义format_args，供format和tooltip共同使用（顺序与RaplConfig::format_args一致）
+    std::string package_power_str = common::format_number(package_power);
+    std::vector<common::format_arg> args = {
+        icon, package_power_str, package_power_str, common::format_number(core_power),
+        common::format_number(other_power)
+    };
 
-uint64_t RaplModule::get_energy_uj(const std::string &path) const {
-    std::ifstream file(path);
-    if (!file.is_open()) {
-        return 0;
-    }
+    std::string display_text = common::safe_execute<std::string>(
+        [&]() { return format.render(args); }, format.source() + " " + icon + " " + package_power_str,
+        "Error formatting output"
+    );
 
-    uint64_t energy = 0;
-    file >> energy;
-    return energy;
-}
+    // 更新标签
+    set_label_text(display_text);
 
-double RaplModule::calculate_power(uint64_t energy_diff, double time_diff_seconds) const {
-    // 转换为焦耳，然后除以时间得到瓦特
-    return (double(energy_diff) / 1000000.0) / time_diff_seconds;
+    // 保存tooltip参数，tooltip在显示时才渲染
+    set_tooltip_args(std::move(args));
 }
 
 #define MODULENAME RaplModule
@@ -1,85 +1,76 @@
 #include <modules/temperature_module.hpp>
-#include <fstream>
 #include <common.hpp>
 #include <filesystem>
 
 namespace waybar::cffi::temperature {
 
+// TemperatureSampler实现
+TemperatureSampler::TemperatureSampler(const std::string &hwmon_path, common::SampleBatch::Backend backend)
+    : base::SharedSampler<TemperatureSample>(backend) {
+    temperature_index_ = sample_batch_.add(hwmon_path);
+}
+
+TemperatureSample TemperatureSampler::collect() {
+    // 处于退避期的传感器本次不读取
+    auto now = common::SourceHealth::clock::now();
+    sample_batch_.set_enabled(temperature_index_, temperature_health_.should_attempt(now));
+    sample_batch_.submit();
+
+    return TemperatureSample{get_temperature(now)};
+}
+
+float TemperatureSampler::get_temperature(common::SourceHealth::clock::time_point now) {
+    // 传感器不可用时按退避间隔重试，期间显示0
+    return temperature_health_.attempt<float>(
+        [&]() {
+            // 温度值通常以毫摄氏度为单位存储
+            auto temperature_c = double(sample_batch_.int64(temperature_index_)) / 1000.0;
+            return static_cast<float>(temperature_c);
+        },
+        0.0f, now
+    );
+}
+
 // TemperatureModule实现
 TemperatureModule::TemperatureModule(
     const wbcffi_init_info *init_info, const wbcffi_config_entry *config_entries, size_t config_entries_len
 )
-    : base::ModuleBase<TemperatureConfig>(init_info, config_entries, config_entries_len) {
+    : base::ModuleBase<TemperatureConfig, TemperatureSample>(init_info, config_entries, config_entries_len) {
+    // 读取同一传感器的实例共享采样器
+    sampler_ = common::SharedRegistry<TemperatureSampler>::acquire(sampler_key(config_->hwmon_path), [&]() {
+        return std::make_shared<TemperatureSampler>(config_->hwmon_path, sample_backend());
+    });
     update();
 }
 
-void TemperatureModule::update() {
-    // 获取当前温度
-    float temperature_c = get_temperature();
+void TemperatureModule::render(const TemperatureSample &sample) {
+    float temperature_c = sample.temperature_c;
 
     // 转换为其他温度单位
     int temperature_c_int = static_cast<int>(std::round(temperature_c));
     int temperature_f_int = static_cast<int>(std::round((temperature_c * 1.8) + 32));
     int temperature_k_int = static_cast<int>(std::round(temperature_c + 273.15));
 
-    // 使用get_state方法设置CSS类并获取状态名称
-    std::string state_name = get_state(temperature_c_int);
+    // 使用get_state方法设置CSS类并获取状态
+    common::KeyId state = get_state(temperature_c_int);
 
     // 获取对应的图标和格式
-    const std::string &icon = get_icon_for_state_name(state_name);
-    const std::string &format = get_format_for_state_name(state_name);
-
-    // 使用公共工具格式化输出
-    std::string temperature_c_str = std::to_string(temperature_c_int);
-    std::string temperature_f_str = std::to_string(temperature_f_int);
-    std::string temperature_k_str = std::to_string(temperature_k_int);
-
-    // 定义format_args，供format和tooltip共同使用
-    std::vector<std::pair<std::string, waybar::cffi::common::format_arg>> args = {
-        {"icon", icon},
-        {"temperature_c", temperature_c_int},
-        {"temperature_f", temperature_f_int},
-        {"temperature_k", temperature_k_int}
-    };
+    const std::string &icon = get_icon(state);
+    const common::FormatTemplate &format = get_format(state);
+
+    // 定义format_args，供format和tooltip共同使用（顺序与TemperatureConfig::format_args一致）
+    std::vector<common::format_arg> args = {icon, temperature_c_int, temperature_f_int, temperature_k_int};
 
     std::string display_text = common::safe_execute<std::string>(
-        [&]() { return common::format_string(format, args); },
-        format + " " + icon + " " + std::to_string(temperature_c_int), "Error formatting output"
+        [&]() { return format.render(args); },
+        format.source() + " " + icon + " " + std::to_string(temperature_c_int), "Error formatting output"
     );
 
     // 更新标签
-    gtk_label_set_text(GTK_LABEL(label_), display_text.c_str());
-
-    // 设置tooltip
-    if (config().tooltip) {
-        auto tooltip_format = get_tooltip_format();
-        std::string tooltip = common::safe_execute<std::string>(
-            [&]() { return common::format_string(tooltip_format, args); },
-            icon + " " + std::to_string(temperature_c_int), "Error formatting tooltip"
-        );
-
-        gtk_widget_set_tooltip_text(event_box_, tooltip.c_str());
-    } else {
-        gtk_widget_set_has_tooltip(event_box_, FALSE);
-    }
-}
+    set_label_text(display_text);
 
-float TemperatureModule::get_temperature() const {
-    std::ifstream file(config_->hwmon_path);
-    if (!file.is_open()) {
-        common::log_error("Failed to open temperature file: {}", config_->hwmon_path);
-        return 0.0f;
-    }
-
-    std::string line;
-    if (!std::getline(file, line)) {
-        common::log_error("Failed to read temperature from: {}", config_->hwmon_path);
-        return 0.0f;
-    }
-
-    // 温度值通常以毫摄氏度为单位存储
-    auto temperature_c = double(std::strtol(line.c_str(), nullptr, 10)) / 1000.0;
-    return static_cast<float>(temperature_c);
+    // 保存tooltip参数，tooltip在显示时才渲染
+    set_tooltip_args(std::move(args));
 }
 
 #define MODULENAME TemperatureModule
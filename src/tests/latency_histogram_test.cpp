@@ -0,0 +1,102 @@
+// LatencyHistogram的分桶和分位数
+#include "test.hpp"
+#include <common.hpp>
+#include <cstdint>
+#include <limits>
+
+using waybar::cffi::common::LatencyHistogram;
+
+namespace {
+
+constexpr uint64_t U64_MAX = std::numeric_limits<uint64_t>::max();
+
+} // namespace
+
+WBC_TEST(histogram_small_values_are_exact) {
+    for (uint64_t v = 0; v < LatencyHistogram::SUB_BUCKETS; ++v) {
+        EXPECT_EQ(LatencyHistogram::bucket_index(v), size_t(v));
+        EXPECT_EQ(LatencyHistogram::bucket_upper_bound(size_t(v)), v);
+    }
+    // [8, 16)的桶宽仍为1，从16开始每个桶覆盖2个值
+    EXPECT_EQ(LatencyHistogram::bucket_index(8), size_t(8));
+    EXPECT_EQ(LatencyHistogram::bucket_index(15), size_t(15));
+    EXPECT_EQ(LatencyHistogram::bucket_index(16), size_t(16));
+    EXPECT_EQ(LatencyHistogram::bucket_index(17), size_t(16));
+    EXPECT_EQ(LatencyHistogram::bucket_index(18), size_t(17));
+    EXPECT_EQ(LatencyHistogram::bucket_upper_bound(16), uint64_t(17));
+}
+
+WBC_TEST(histogram_bucket_edges_are_contiguous) {
+    // 每个桶的上界属于该桶，上界加一属于下一个桶
+    for (size_t i = 0; i + 1 < LatencyHistogram::BUCKET_COUNT; ++i) {
+        uint64_t upper = LatencyHistogram::bucket_upper_bound(i);
+        EXPECT_EQ(LatencyHistogram::bucket_index(upper), i);
+        EXPECT_EQ(LatencyHistogram::bucket_index(upper + 1), i + 1);
+    }
+    // 2的幂区间的边界
+    EXPECT_EQ(LatencyHistogram::bucket_index(1023), size_t(63));
+    EXPECT_EQ(LatencyHistogram::bucket_index(1024), size_t(64));
+    EXPECT_EQ(LatencyHistogram::bucket_upper_bound(63), uint64_t(1023));
+    EXPECT_EQ(LatencyHistogram::bucket_upper_bound(64), uint64_t(1024 + 127));
+}
+
+WBC_TEST(histogram_relative_error_is_bounded) {
+    // 桶宽不超过桶下界的1/8
+    for (size_t i = LatencyHistogram::SUB_BUCKETS; i < LatencyHistogram::BUCKET_COUNT; ++i) {
+        uint64_t lower = LatencyHistogram::bucket_upper_bound(i - 1) + 1;
+        uint64_t upper = LatencyHistogram::bucket_upper_bound(i);
+        EXPECT_TRUE(upper - lower <= lower / LatencyHistogram::SUB_BUCKETS);
+    }
+}
+
+WBC_TEST(histogram_saturates_at_last_bucket) {
+    EXPECT_EQ(LatencyHistogram::bucket_index(U64_MAX), LatencyHistogram::BUCKET_COUNT - 1);
+    EXPECT_EQ(LatencyHistogram::bucket_index(uint64_t(1) << 63), LatencyHistogram::BUCKET_COUNT - 8);
+    EXPECT_EQ(LatencyHistogram::bucket_upper_bound(LatencyHistogram::BUCKET_COUNT - 1), U64_MAX);
+
+    LatencyHistogram hist;
+    hist.record(0);
+    hist.record(U64_MAX);
+    EXPECT_EQ(hist.count(), uint64_t(2));
+    EXPECT_EQ(hist.max(), U64_MAX);
+    EXPECT_EQ(hist.percentile(0.5), uint64_t(0));
+    EXPECT_EQ(hist.percentile(1.0), U64_MAX);
+}
+
+WBC_TEST(histogram_empty_percentile_is_zero) {
+    LatencyHistogram hist;
+    EXPECT_EQ(hist.count(), uint64_t(0));
+    EXPECT_EQ(hist.percentile(0.0), uint64_t(0));
+    EXPECT_EQ(hist.percentile(0.99), uint64_t(0));
+}
+
+WBC_TEST(histogram_percentile_reports_bucket_upper_bound) {
+    LatencyHistogram hist;
+    for (uint64_t v = 1; v <= 1000; ++v) {
+        hist.record(v);
+    }
+    // 第500个值落在[480, 511]，报告桶上界
+    EXPECT_EQ(hist.percentile(0.5), uint64_t(511));
+    // 第990个值落在[960, 1023]，上界被实际最大值截断
+    EXPECT_EQ(hist.percentile(0.99), uint64_t(1000));
+    EXPECT_EQ(hist.percentile(1.0), uint64_t(1000));
+    // q越界时按[0, 1]处理，q = 0取第一个值
+    EXPECT_EQ(hist.percentile(0.0), uint64_t(1));
+    EXPECT_EQ(hist.percentile(-1.0), uint64_t(1));
+    EXPECT_EQ(hist.percentile(2.0), uint64_t(1000));
+}
+
+WBC_TEST(histogram_percentile_at_bucket_edges) {
+    // 15是宽度为1的桶的最后一个值，16是第一个宽度为2的桶[16, 17]的下界
+    LatencyHistogram hist;
+    for (int i = 0; i < 4; ++i) {
+        hist.record(15);
+        hist.record(16);
+    }
+    hist.record(100);
+    // 9个记录中秩4和5分别是最后一个15和第一个16
+    EXPECT_EQ(hist.percentile(0.4), uint64_t(15));
+    EXPECT_EQ(hist.percentile(0.5), uint64_t(17));
+    // 最大值所在的桶[96, 103]被截断为100
+    EXPECT_EQ(hist.percentile(1.0), uint64_t(100));
+}
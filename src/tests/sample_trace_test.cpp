@@ -0,0 +1,191 @@
+// SampleTrace的记录、回放和对损坏文件的处理
+#include "test.hpp"
+#include <common.hpp>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+using waybar::cffi::common::SampleTrace;
+using waybar::cffi::common::SysfsReader;
+
+namespace {
+
+// 每个测试使用自己的临时文件，结束时删除并让轨迹回到关闭状态
+class TempTrace {
+  public:
+    explicit TempTrace(const char *name)
+        : path_((std::filesystem::temp_directory_path() / fmt::format("wbc-{}-{}", name, ::getpid())).string()) {
+    }
+
+    ~TempTrace() {
+        SampleTrace::instance().stop();
+        std::filesystem::remove(path_);
+    }
+
+    const std::string &path() const {
+        return path_;
+    }
+
+  private:
+    std::string path_;
+};
+
+SampleTrace::clock::time_point at_ns(int64_t ns) {
+    return SampleTrace::clock::time_point(std::chrono::nanoseconds(ns));
+}
+
+int64_t ns_of(const SampleTrace::Record &record) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(record.timestamp.time_since_epoch()).count();
+}
+
+// 记录三次读取：/a两次成功，/b一次失败
+void record_three(const std::string &path) {
+    SampleTrace &trace = SampleTrace::instance();
+    EXPECT_TRUE(trace.start_recording(path));
+    EXPECT_TRUE(trace.recording());
+    trace.record("/a", at_ns(100), "hello", 5);
+    trace.record("/b", at_ns(200), nullptr, 0);
+    trace.record("/a", at_ns(300), "world\n", 6);
+    trace.stop();
+    EXPECT_FALSE(trace.recording());
+}
+
+void write_file(const std::string &path, const std::string &content) {
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << content;
+}
+
+std::string read_file(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+size_t count_reads(std::string_view path) {
+    size_t cursor = 0;
+    SampleTrace::Record record;
+    while (SampleTrace::instance().replay(path, cursor, record)) {
+    }
+    return cursor;
+}
+
+} // namespace
+
+WBC_TEST(trace_round_trip_preserves_reads_and_timestamps) {
+    TempTrace file("roundtrip");
+    record_three(file.path());
+
+    SampleTrace &trace = SampleTrace::instance();
+    EXPECT_TRUE(trace.start_replay(file.path()));
+    EXPECT_TRUE(trace.replaying());
+
+    size_t cursor = 0;
+    SampleTrace::Record record;
+    EXPECT_TRUE(trace.replay("/a", cursor, record));
+    EXPECT_TRUE(record.ok);
+    EXPECT_EQ(record.data, std::string_view("hello"));
+    EXPECT_EQ(ns_of(record), int64_t(100));
+    EXPECT_TRUE(trace.replay("/a", cursor, record));
+    EXPECT_EQ(record.data, std::string_view("world\n"));
+    EXPECT_EQ(ns_of(record), int64_t(300));
+    EXPECT_FALSE(trace.replay("/a", cursor, record));
+    EXPECT_EQ(cursor, size_t(2));
+
+    cursor = 0;
+    EXPECT_TRUE(trace.replay("/b", cursor, record));
+    EXPECT_FALSE(record.ok);
+    EXPECT_EQ(ns_of(record), int64_t(200));
+
+    cursor = 0;
+    EXPECT_FALSE(trace.replay("/missing", cursor, record));
+}
+
+WBC_TEST(trace_round_trip_through_sysfs_reader) {
+    TempTrace file("reader");
+    std::string source = file.path() + ".src";
+    write_file(source, "42\n");
+
+    SampleTrace &trace = SampleTrace::instance();
+    EXPECT_TRUE(trace.start_recording(file.path()));
+    {
+        SysfsReader reader(source);
+        EXPECT_EQ(reader.read_uint64(), uint64_t(42));
+        write_file(source, "43\n");
+        EXPECT_EQ(reader.read_uint64(), uint64_t(43));
+    }
+    trace.stop();
+
+    // 回放不访问源文件
+    std::filesystem::remove(source);
+    EXPECT_TRUE(trace.start_replay(file.path()));
+    SysfsReader reader(source);
+    EXPECT_EQ(reader.read_uint64(), uint64_t(42));
+    EXPECT_EQ(reader.read_uint64(), uint64_t(43));
+    bool exhausted = false;
+    try {
+        reader.read_uint64();
+    } catch (const std::runtime_error &) {
+        exhausted = true;
+    }
+    EXPECT_TRUE(exhausted);
+}
+
+WBC_TEST(trace_truncated_file_keeps_complete_records) {
+    TempTrace file("truncated");
+    record_three(file.path());
+    std::string full = read_file(file.path());
+
+    // 截掉最后一条记录的最后一个字节：只保留前两条
+    EXPECT_EQ(::truncate(file.path().c_str(), static_cast<off_t>(full.size() - 1)), 0);
+    EXPECT_TRUE(SampleTrace::instance().start_replay(file.path()));
+    EXPECT_EQ(count_reads("/a"), size_t(1));
+    EXPECT_EQ(count_reads("/b"), size_t(1));
+    SampleTrace::instance().stop();
+
+    // 截在第一条读取记录的头部中间：文件头有效，但没有读取
+    EXPECT_EQ(::truncate(file.path().c_str(), 16 + 1 + 4 + 4 + 2 + 1 + 4 + 3), 0);
+    EXPECT_TRUE(SampleTrace::instance().start_replay(file.path()));
+    EXPECT_EQ(count_reads("/a"), size_t(0));
+    SampleTrace::instance().stop();
+
+    // 文件头本身不完整
+    EXPECT_EQ(::truncate(file.path().c_str(), 12), 0);
+    EXPECT_FALSE(SampleTrace::instance().start_replay(file.path()));
+    EXPECT_FALSE(SampleTrace::instance().replaying());
+}
+
+WBC_TEST(trace_rejects_foreign_or_newer_files) {
+    TempTrace file("corrupt");
+    record_three(file.path());
+    std::string valid = read_file(file.path());
+
+    std::string bad_magic = valid;
+    bad_magic[0] = 'X';
+    write_file(file.path(), bad_magic);
+    EXPECT_FALSE(SampleTrace::instance().start_replay(file.path()));
+
+    std::string newer = valid;
+    uint32_t version = 2;
+    std::memcpy(newer.data() + 8, &version, sizeof(version));
+    write_file(file.path(), newer);
+    EXPECT_FALSE(SampleTrace::instance().start_replay(file.path()));
+    EXPECT_FALSE(SampleTrace::instance().replaying());
+
+    EXPECT_FALSE(SampleTrace::instance().start_replay(file.path() + ".missing"));
+}
+
+WBC_TEST(trace_unknown_record_type_ends_the_index) {
+    TempTrace file("unknown");
+    record_three(file.path());
+    std::string data = read_file(file.path());
+
+    // 在第一条读取记录之后插入未知类型：之后的记录被忽略
+    size_t first_read_end = 16 + (1 + 4 + 4 + 2) + (1 + 4 + 8 + 4 + 5);
+    data.insert(first_read_end, 1, char(9));
+    write_file(file.path(), data);
+    EXPECT_TRUE(SampleTrace::instance().start_replay(file.path()));
+    EXPECT_EQ(count_reads("/a"), size_t(1));
+    EXPECT_EQ(count_reads("/b"), size_t(0));
+}
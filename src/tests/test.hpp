@@ -0,0 +1,60 @@
+// 单元测试的最小框架：WBC_TEST定义并注册测试，
+// EXPECT_*失败时记录位置和实际值并继续执行
+// 测试在test_main.cpp中按注册顺序运行，任何断言失败时进程返回1
+#ifndef WAYBAR_CFFI_TEST_HPP
+#define WAYBAR_CFFI_TEST_HPP
+
+#include <fmt/format.h>
+#include <string>
+#include <vector>
+
+namespace waybar::cffi::test {
+
+using TestFunc = void (*)();
+
+struct TestCase {
+    const char *name;
+    TestFunc func;
+};
+
+// 所有注册的测试，按静态初始化顺序排列（同一文件内按定义顺序）
+std::vector<TestCase> &registry();
+
+struct Registration {
+    Registration(const char *name, TestFunc func) {
+        registry().push_back(TestCase{name, func});
+    }
+};
+
+// 记录一次断言失败
+void report_failure(const char *file, int line, const std::string &message);
+
+} // namespace waybar::cffi::test
+
+#define WBC_TEST(name)                                                                                                 \
+    static void name();                                                                                                \
+    static const ::waybar::cffi::test::Registration name##_registration(#name, name);                                  \
+    static void name()
+
+#define EXPECT_TRUE(cond)                                                                                              \
+    do {                                                                                                               \
+        if (!(cond)) {                                                                                                 \
+            ::waybar::cffi::test::report_failure(__FILE__, __LINE__, "expected true: " #cond);                         \
+        }                                                                                                              \
+    } while (false)
+
+#define EXPECT_FALSE(cond) EXPECT_TRUE(!(cond))
+
+#define EXPECT_EQ(actual, expected)                                                                                    \
+    do {                                                                                                               \
+        const auto &actual_value = (actual);                                                                           \
+        const auto &expected_value = (expected);                                                                       \
+        if (!(actual_value == expected_value)) {                                                                       \
+            ::waybar::cffi::test::report_failure(                                                                      \
+                __FILE__, __LINE__,                                                                                    \
+                fmt::format("{} == {}: got {}, expected {}", #actual, #expected, actual_value, expected_value)         \
+            );                                                                                                         \
+        }                                                                                                              \
+    } while (false)
+
+#endif // WAYBAR_CFFI_TEST_HPP
@@ -0,0 +1,47 @@
+// 单元测试入口：依次运行所有注册的测试，可以用测试名的子串作为参数只运行部分测试
+// 例如: waybar_cffi_tests histogram
+#include "test.hpp"
+#include <common.hpp>
+#include <cstdio>
+#include <cstring>
+
+namespace waybar::cffi::test {
+
+namespace {
+size_t failures = 0;
+} // namespace
+
+std::vector<TestCase> &registry() {
+    static std::vector<TestCase> tests;
+    return tests;
+}
+
+void report_failure(const char *file, int line, const std::string &message) {
+    ++failures;
+    std::fprintf(stderr, "%s:%d: %s\n", file, line, message.c_str());
+}
+
+} // namespace waybar::cffi::test
+
+int main(int argc, char **argv) {
+    using namespace waybar::cffi;
+    const char *filter = argc > 1 ? argv[1] : nullptr;
+    common::set_log_level(common::LogLevel::Error);
+
+    size_t run = 0;
+    size_t failed = 0;
+    for (const test::TestCase &test_case : test::registry()) {
+        if (filter && !std::strstr(test_case.name, filter)) {
+            continue;
+        }
+        size_t failures_before = test::failures;
+        test_case.func();
+        ++run;
+        bool passed = test::failures == failures_before;
+        failed += passed ? 0 : 1;
+        std::printf("[%s] %s\n", passed ? " OK " : "FAIL", test_case.name);
+    }
+
+    std::printf("%zu tests, %zu failed\n", run, failed);
+    return failed == 0 ? 0 : 1;
+}
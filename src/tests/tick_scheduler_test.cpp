@@ -0,0 +1,88 @@
+// TickScheduler的对齐和时钟校正
+#include "test.hpp"
+#include <tick_scheduler.hpp>
+#include <algorithm>
+
+using waybar::cffi::common::TickScheduler;
+
+namespace {
+
+// 2026-01-01 00:00:00 UTC，整秒
+constexpr int64_t BASE_MS = 1767225600000;
+
+// 与dispatch()相同：到期的任务对齐到当前时刻之后的边界，错过的边界不补发
+int64_t advance(int64_t next_ms, int64_t now_ms, uint32_t interval_ms) {
+    return TickScheduler::align_next(std::max(now_ms, next_ms), interval_ms);
+}
+
+} // namespace
+
+WBC_TEST(align_next_from_boundary_is_strictly_later) {
+    EXPECT_EQ(TickScheduler::align_next(BASE_MS, 1000), BASE_MS + 1000);
+    EXPECT_EQ(TickScheduler::align_next(BASE_MS + 1, 1000), BASE_MS + 1000);
+    EXPECT_EQ(TickScheduler::align_next(BASE_MS + 999, 1000), BASE_MS + 1000);
+    EXPECT_EQ(TickScheduler::align_next(BASE_MS + 10, 250), BASE_MS + 250);
+    EXPECT_EQ(TickScheduler::align_next(0, 1), int64_t(1));
+}
+
+WBC_TEST(align_next_with_interval_not_dividing_a_second) {
+    // 300ms和700ms的边界是从纪元开始的整倍数，不一定落在整秒上
+    constexpr uint32_t interval = 300;
+    int64_t next = TickScheduler::align_next(BASE_MS, interval);
+    EXPECT_EQ(next % interval, int64_t(0));
+    EXPECT_TRUE(next > BASE_MS && next <= BASE_MS + interval);
+    EXPECT_EQ(advance(next, next, interval), next + interval);
+
+    int64_t seven = TickScheduler::align_next(BASE_MS + 1, 700);
+    EXPECT_EQ(seven % 700, int64_t(0));
+    EXPECT_TRUE(seven > BASE_MS + 1 && seven <= BASE_MS + 701);
+}
+
+WBC_TEST(clamp_keeps_deadlines_within_one_interval) {
+    // 正常情况：下一次触发在一个间隔以内，不修改
+    int64_t next = BASE_MS + 1000;
+    TickScheduler::clamp_to_clock(next, BASE_MS, 1000);
+    EXPECT_EQ(next, BASE_MS + 1000);
+
+    next = BASE_MS + 1000;
+    TickScheduler::clamp_to_clock(next, BASE_MS + 500, 1000);
+    EXPECT_EQ(next, BASE_MS + 1000);
+}
+
+WBC_TEST(clamp_realigns_after_backwards_step) {
+    // 墙上时钟回拨一小时：原来的时刻远在未来，重新对齐到回拨后的下一个边界
+    int64_t next = BASE_MS + 1000;
+    int64_t now = BASE_MS - 3600 * 1000 + 250;
+    TickScheduler::clamp_to_clock(next, now, 1000);
+    EXPECT_EQ(next, BASE_MS - 3600 * 1000 + 1000);
+
+    // 回拨后下一次时刻仍在一个间隔以内时保持不变（BASE_MS + 300回拨到BASE_MS）
+    next = BASE_MS + 1000;
+    TickScheduler::clamp_to_clock(next, BASE_MS, 1000);
+    EXPECT_EQ(next, BASE_MS + 1000);
+
+    // 超出一个间隔时对齐到回拨后的第一个边界，最多等待一个间隔
+    next = BASE_MS + 1000;
+    TickScheduler::clamp_to_clock(next, BASE_MS - 400, 1000);
+    EXPECT_EQ(next, BASE_MS);
+
+    // 不整除1000的间隔同样对齐到间隔的整倍数
+    next = TickScheduler::align_next(BASE_MS, 300);
+    now = BASE_MS - 60 * 1000;
+    TickScheduler::clamp_to_clock(next, now, 300);
+    EXPECT_EQ(next, TickScheduler::align_next(now, 300));
+    EXPECT_TRUE(next > now && next <= now + 300);
+}
+
+WBC_TEST(forward_jump_skips_missed_boundaries) {
+    // 墙上时钟前跳（或系统休眠）时任务已到期，clamp不修改；
+    // 触发后对齐到当前时刻之后，不补发错过的边界
+    int64_t next = BASE_MS + 1000;
+    int64_t now = BASE_MS + 3600 * 1000 + 10;
+    TickScheduler::clamp_to_clock(next, now, 1000);
+    EXPECT_EQ(next, BASE_MS + 1000);
+    EXPECT_EQ(advance(next, now, 1000), BASE_MS + 3601 * 1000);
+
+    // 没有跳变时按间隔前进
+    EXPECT_EQ(advance(BASE_MS + 1000, BASE_MS + 1001, 1000), BASE_MS + 2000);
+}
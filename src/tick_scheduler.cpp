@@ -0,0 +1,142 @@
+#include <tick_scheduler.hpp>
+#include <algorithm>
+
+namespace waybar::cffi::common {
+
+namespace {
+
+// 墙上时钟换算到单调时钟时按毫秒取整，唤醒可能略早于对齐边界，允许的提前量
+constexpr int64_t EARLY_TOLERANCE_MS = 1;
+
+// 调度器使用的GSource，携带所属调度器
+struct TickSource {
+    GSource source;
+    TickScheduler *scheduler;
+};
+
+// 墙上时钟与单调时钟的差值，按毫秒取整，保证各调度器换算出的唤醒时刻相同
+int64_t realtime_offset_us() {
+    int64_t offset = g_get_real_time() - g_get_monotonic_time();
+    return (offset + 500) / 1000 * 1000;
+}
+
+} // namespace
+
+TickScheduler &TickScheduler::instance() {
+    static TickScheduler scheduler;
+    return scheduler;
+}
+
+int64_t TickScheduler::align_next(int64_t t_ms, uint32_t interval_ms) {
+    return (t_ms / interval_ms + 1) * interval_ms;
+}
+
+void TickScheduler::clamp_to_clock(int64_t &next_ms, int64_t now_ms, uint32_t interval_ms) {
+    if (next_ms > now_ms + interval_ms) {
+        next_ms = align_next(now_ms, interval_ms);
+    }
+}
+
+TickScheduler::~TickScheduler() {
+    if (source_) {
+        g_source_destroy(source_);
+        g_source_unref(source_);
+        source_ = nullptr;
+    }
+}
+
+guint TickScheduler::add(uint32_t interval_ms, Callback callback, void *user_data) {
+    interval_ms = std::max<uint32_t>(interval_ms, 1);
+    int64_t now_ms = g_get_real_time() / 1000;
+
+    guint id = next_id_++;
+    tasks_.push_back(Task{id, interval_ms, align_next(now_ms, interval_ms), callback, user_data});
+
+    if (!dispatching_) {
+        reschedule();
+    }
+    return id;
+}
+
+void TickScheduler::remove(guint id) {
+    auto it = std::find_if(tasks_.begin(), tasks_.end(), [id](const Task &task) { return task.id == id; });
+    if (it == tasks_.end()) {
+        return;
+    }
+
+    if (dispatching_) {
+        // 正在遍历任务表，先标记，分发结束后统一清理
+        it->callback = nullptr;
+    } else {
+        tasks_.erase(it);
+        reschedule();
+    }
+}
+
+void TickScheduler::dispatch() {
+    ++wakeups_;
+    dispatching_ = true;
+
+    int64_t real_ms = g_get_real_time() / 1000;
+    int64_t now_ms = real_ms + EARLY_TOLERANCE_MS;
+
+    // 回调中可能添加或移除任务，按下标遍历并在调用前复制所需字段
+    for (size_t i = 0; i < tasks_.size(); ++i) {
+        Task &task = tasks_[i];
+        clamp_to_clock(task.next_ms, real_ms, task.interval_ms);
+        if (task.callback == nullptr || task.next_ms > now_ms) {
+            continue;
+        }
+
+        // 错过的边界（例如系统休眠）不补发，直接对齐到下一个边界
+        task.next_ms = align_next(std::max(now_ms, task.next_ms), task.interval_ms);
+
+        Callback callback = task.callback;
+        void *user_data = task.user_data;
+        ++dispatches_;
+        callback(user_data);
+    }
+
+    dispatching_ = false;
+    std::erase_if(tasks_, [](const Task &task) { return task.callback == nullptr; });
+    reschedule();
+}
+
+void TickScheduler::reschedule() {
+    if (tasks_.empty()) {
+        if (source_) {
+            g_source_destroy(source_);
+            g_source_unref(source_);
+            source_ = nullptr;
+        }
+        return;
+    }
+
+    if (!source_) {
+        static GSourceFuncs funcs = {nullptr, nullptr, source_dispatch, nullptr, nullptr, nullptr};
+        source_ = g_source_new(&funcs, sizeof(TickSource));
+        reinterpret_cast<TickSource *>(source_)->scheduler = this;
+        g_source_set_name(source_, "waybar-cffi-tick");
+        g_source_attach(source_, nullptr);
+    }
+
+    int64_t now_ms = g_get_real_time() / 1000;
+    for (Task &task : tasks_) {
+        clamp_to_clock(task.next_ms, now_ms, task.interval_ms);
+    }
+
+    // 只按最早的到期时刻设置一次唤醒
+    int64_t next_ms = std::min_element(tasks_.begin(), tasks_.end(), [](const Task &a, const Task &b) {
+                          return a.next_ms < b.next_ms;
+                      })->next_ms;
+    g_source_set_ready_time(source_, next_ms * 1000 - realtime_offset_us());
+}
+
+gboolean TickScheduler::source_dispatch(GSource *source, GSourceFunc callback, gpointer user_data) {
+    (void)callback;
+    (void)user_data;
+    reinterpret_cast<TickSource *>(source)->scheduler->dispatch();
+    return G_SOURCE_CONTINUE;
+}
+
+} // namespace waybar::cffi::common